@@ -4,6 +4,7 @@
 #include "data_types.h"
 #include <eigen3/Eigen/Dense>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -231,17 +232,40 @@ inline void printTGProblem(const TGProblem& p)
 	cout << p.doLimitAcceleration << endl;
 }
 
+// slice a box in two along axis, each half gets half of its time
+inline bool sliceBoxInTwo(const Box& box, const char axis, Box& half1, Box& half2)
+{
+	Box source = box;  // sliceIntoTwo resets the bounds of the box it slices
+
+	std::vector< std::pair<double, double> > new_bound1, new_bound2;
+
+	if (!source.sliceIntoTwo(axis, new_bound1, new_bound2))
+	{
+		cout << "[Error]Cannot slice a box." << endl;
+		return false;
+	}
+
+	half1 = Box(new_bound1);
+	half2 = Box(new_bound2);
+
+	half1.setBox();
+	half2.setBox();
+
+	half1.t = box.t / 2;
+	half2.t = box.t / 2;
+
+	return true;
+}
+
 // We do not slice the first and the last corridor
 // The slicing strategy is this: if there is n+2 segments, and we want k more segments
 // we will slice each of the n segments (segments in the middle) once:
 // E.g. n = 2, k = 3, then we first slice the 2nd segment into 2 segments, then the 3rd (the original), then 2nd again.
-inline bool sliceCorridor(TGProblem& problem, vector<char> sliceDirections, const unsigned int sliceTimes)
+// After r full rounds every middle box is cut into 2^r pieces, the remaining slices go to the first pieces in order,
+// so the new corridor is built box by box into a fresh buffer. On error the corridor is left as it is.
+inline bool sliceCorridor(TGProblem& problem, const vector<char>& sliceDirections, const unsigned int sliceTimes)
 {
-	vector<Box>& corridor = problem.corridor;
-
-	unsigned int corridorLength = corridor.size();
-
-	cout << "Corridor size: " << corridor.size() << endl;
+	const vector<Box>& corridor = problem.corridor;
 
 	if (corridor.size() <= 2)
 	{
@@ -260,74 +284,122 @@ inline bool sliceCorridor(TGProblem& problem, vector<char> sliceDirections, cons
 		cout << "sliceTimes must be larger than 0" << endl;
 		return false;
 	}
-    
-    // we slice from the 2nd segment
-	unsigned int whichToSlice = 1;
-	unsigned int localSliceTimes = 0;
 
-	for (unsigned int i = 0; i < sliceTimes; ++i)
+	// the number of full rounds, and the slices left for the last one
+	unsigned int rounds = 0;
+	size_t roundSize = corridor.size() - 2;
+	size_t rest = sliceTimes;
+	while (rest >= roundSize)
 	{
-		cout << "--> Slicing No." << whichToSlice << endl;
-		Box& boxToSlice = corridor[whichToSlice];
+		rest -= roundSize;
+		roundSize *= 2;
+		rounds++;
+	}
 
-		boxToSlice.setBox();
+	vector<Box> sliced;
+	sliced.reserve(corridor.size() + sliceTimes);
+	sliced.push_back(corridor.front());
 
-		std::vector< std::pair<double, double> > new_bound1, new_bound2;
+	vector<Box> pieces, halves;
+	Box half1, half2;
+	size_t whichPiece = 0;  // among the middle boxes of the last round
 
-		if (!boxToSlice.sliceIntoTwo(sliceDirections[whichToSlice], new_bound1, new_bound2))
-		{
-			cout << "[Error]Cannot slice a box." << endl;
-			return false;
+	for (unsigned int i = 1; i + 1 < corridor.size(); ++i)
+	{
+		pieces.assign(1, corridor[i]);
 
+		for (unsigned int r = 0; r < rounds; ++r)
+		{
+			halves.clear();
+			for (unsigned int j = 0; j < pieces.size(); ++j)
+			{
+				if (!sliceBoxInTwo(pieces[j], sliceDirections[i], half1, half2))
+					return false;
+				halves.push_back(half1);
+				halves.push_back(half2);
+			}
+			pieces.swap(halves);
 		}
-		
-		Box newBox1(new_bound1);
-	    Box newBox2(new_bound2);
-
-	    newBox1.setBox();
-	    newBox2.setBox();
-
-	    newBox1.t = boxToSlice.t / 2;
-	    newBox2.t = boxToSlice.t / 2;
-        
-        // erase the one being sliced
-	    corridor.erase(corridor.begin() + whichToSlice);
-
-	    // insert new ones
-	    vector<Box> slicedBoxes;
-	    slicedBoxes.push_back(newBox1);
-	    slicedBoxes.push_back(newBox2);
-	    
-	    corridor.insert(corridor.begin() + whichToSlice, slicedBoxes.begin(), slicedBoxes.end());
-
-	    sliceDirections.insert(sliceDirections.begin() + whichToSlice, sliceDirections[whichToSlice]);
-
-        whichToSlice += 2;
-		localSliceTimes++;
-        
-        // if we have sliced every segment (exceopt the first and the last)
-        // we start from the 2nd segment again
-		if (localSliceTimes >= corridorLength - 2)
+
+		for (unsigned int j = 0; j < pieces.size(); ++j, ++whichPiece)
 		{
-			localSliceTimes = 0;
-			whichToSlice = 1;
+			if (whichPiece < rest)
+			{
+				if (!sliceBoxInTwo(pieces[j], sliceDirections[i], half1, half2))
+					return false;
+				sliced.push_back(half1);
+				sliced.push_back(half2);
+			}
+			else
+			{
+				sliced.push_back(pieces[j]);
+			}
+		}
+	}
 
-			corridorLength = corridor.size();
+	sliced.push_back(corridor.back());
+	problem.corridor.swap(sliced);
 
-			cout << "[INFO] We start over again." << endl;
-		}
+	return true;
+}
 
-		cout << "Directions: ";
-		for (unsigned int i = 0; i < sliceDirections.size(); ++i)
+// Slice only where the trajectory is held by the corridor or the limits: the middle boxes with the largest activity,
+// e.g. TimeAllocator::segment_activity from the multipliers of a solution, each sliced once. At most maxSlices boxes
+// are sliced and none with activity not above tol, so segments are added only where a constraint costs something.
+// sliceDirections is updated to match the new corridor. Returns the number of boxes sliced, -1 on error.
+inline int sliceCorridorAdaptive(TGProblem& problem, vector<char>& sliceDirections, const unsigned int maxSlices,
+                                 const Eigen::VectorXd& activity, const double tol = 1e-6)
+{
+	const vector<Box>& corridor = problem.corridor;
+
+	if (corridor.size() != sliceDirections.size() || (size_t)activity.size() != corridor.size())
+	{
+		cout << "[Error]sliceDirections and activity should have the same #segments as the corridor" << endl;
+		return -1;
+	}
+
+	vector<unsigned int> candidates;
+	for (unsigned int i = 1; i + 1 < corridor.size(); ++i)
+	{
+		if (activity(i) > tol)
+			candidates.push_back(i);
+	}
+
+	unsigned int numSlice = std::min<size_t>(maxSlices, candidates.size());
+	std::partial_sort(candidates.begin(), candidates.begin() + numSlice, candidates.end(),
+	                  [&activity](unsigned int a, unsigned int b) { return activity(a) > activity(b); });
+
+	vector<bool> toSlice(corridor.size(), false);
+	for (unsigned int k = 0; k < numSlice; ++k)
+		toSlice[candidates[k]] = true;
+
+	vector<Box> sliced;
+	vector<char> directions;
+	sliced.reserve(corridor.size() + numSlice);
+	directions.reserve(corridor.size() + numSlice);
+
+	Box half1, half2;
+	for (unsigned int i = 0; i < corridor.size(); ++i)
+	{
+		if (toSlice[i])
 		{
-			cout << sliceDirections[i] << " ";
+			if (!sliceBoxInTwo(corridor[i], sliceDirections[i], half1, half2))
+				return -1;
+			sliced.push_back(half1);
+			sliced.push_back(half2);
+			directions.push_back(sliceDirections[i]);
 		}
-		cout << endl;
-
+		else
+		{
+			sliced.push_back(corridor[i]);
+		}
+		directions.push_back(sliceDirections[i]);
 	}
 
-	return true;
+	problem.corridor.swap(sliced);
+	sliceDirections.swap(directions);
 
+	return numSlice;
 }
 
-#endif /* _TGProblem_H_ */
\ No newline at end of file
+#endif /* _TGProblem_H_ */
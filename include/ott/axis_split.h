@@ -0,0 +1,67 @@
+/*
+ * axis_split.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef AXIS_SPLIT_H
+#define AXIS_SPLIT_H
+
+#include <vector>
+
+#include "ott/pybind_box_type.h"
+#include "ott/qp_solver.h"
+#include "ott/thread_pool.h"
+
+
+/* Nothing in the problem couples the x, y and z control points: the cost has one MQM block per axis and every
+ * constraint row only touches one axis. AxisSplitQP cuts the QP into the three per-axis problems, solves them
+ * with their own QPSolver (concurrently on threads kept between solves if there is more than one core) and merges
+ * the results back into the layout of the full problem, so x, lmdy and lmdz can go to gradient_from_P and
+ * gradient_from_A as before.
+ * The sub-matrix patterns are found once, solve only gathers the current values.
+ */
+class AxisSplitQP{
+public:
+    QPSolver qp[3];
+    bool parallel = true;  // one thread per axis, turn off when called from the workers of another pool
+
+    // merged results, same meaning as in QPSolver
+    VX x, lmdy, lmdz;
+    double obj = 0;
+    int status = QP_UNSOLVED;
+    int iter = 0;  // the largest over the axes
+
+    AxisSplitQP(){}
+
+    // P is the lower triangle of the objective, n_poly the number of control points per axis and segment
+    AxisSplitQP(const SpMX &P, const SpMX &A, int n_poly);
+
+    // false if some row of A mixes axes, the split is then not usable
+    bool is_valid() const {return valid;}
+
+    // P and A must have the pattern given at construction
+    int solve(const SpMX &P, const SpMX &A, cRefVX clb, cRefVX cub, cRefVX xlb, cRefVX xub);
+
+    void reset();
+
+    // take over the last solve of other, the solvers of each axis as QPSolver::take_solution
+    void take_solution(const AxisSplitQP &other);
+
+private:
+    struct Axis{
+        std::vector<int> var;  // global index of the variables of this axis
+        std::vector<int> row;  // global index of the constraint rows of this axis
+        SpMX P, A;
+        std::vector<int> p_src, a_src;  // for each value of P and A, its position in the full matrix
+        VX clb, cub, xlb, xub;
+    };
+    Axis axis[3];
+    bool valid = false;
+    WorkStealingPool pool{3};  // its threads start with the first parallel solve
+
+    void solve_axis(int p);
+};
+
+#endif /* !AXIS_SPLIT_H */
@@ -0,0 +1,93 @@
+/*
+ * banded_ipm.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef BANDED_IPM_H
+#define BANDED_IPM_H
+
+#include <vector>
+#include <eigen3/Eigen/Dense>
+
+#include "ott/pybind_box_type.h"
+#include "ott/qp_solver.h"
+
+
+struct IPMSettings{
+    double eps_abs = 1e-8;  // on the residuals and the average complementarity
+    double eps_rel = 1e-8;
+    int max_iter = 100;
+    double step_ratio = 0.99;  // fraction of the step to the boundary
+    double reg = 1e-10;  // regularization on the segment blocks and on the Schur complement, raised only if a factorization fails
+    int refine_iter = 1;  // iterative refinement steps of each Newton solve
+};
+
+
+/* Primal-dual interior point method (Mehrotra predictor-corrector) for the same QP as QPSolver,
+ * exploiting that the variables come in segments of seg_size consecutive columns.
+ * Every inequality row (velocity, acceleration) and every variable bound lies within one segment and every equality row
+ * (start, end, joints) within two consecutive ones, so after eliminating the inequalities the Hessian is block diagonal and
+ * the Schur complement on the equality rows is block tridiagonal. Both are factored with dense blocks in time linear in the
+ * number of segments. Rows with clb == cub are equalities, bounds beyond 1e19 in magnitude are ignored.
+ * Dual variables follow the same convention as QPSolver, so gradient_from_A can use them.
+ */
+class BandedIPMSolver{
+public:
+    IPMSettings settings;
+
+    // results of the last solve
+    VX x, lmdy, lmdz;
+    double obj = 0;
+    int status = QP_UNSOLVED;
+    int iter = 0;
+    double prim_res = 0, dual_res = 0, gap = 0;
+
+    BandedIPMSolver(){}
+    BandedIPMSolver(int seg_size_, const IPMSettings &settings_ = IPMSettings()) : settings(settings_), seg_size(seg_size_){}
+
+    // only the lower triangle of P is read, returns QP_INVALID_DATA if a row or block of P crosses the banded structure
+    int solve(const SpMX &P, cRefVX q, const SpMX &A, cRefVX clb, cRefVX cub, cRefVX xlb, cRefVX xub);
+
+    // solve directly from the output of construct_P_matrix and construct_A_matrix
+    int solve_triplets(cRefVX pval, const lVX &prow, const lVX &pcol, const LinearConstr &lincon);
+
+    bool is_solved() const {return status > 0;}
+
+private:
+    int seg_size = 0;
+    int n = 0, m = 0, n_seg = 0;
+
+    struct Segment{
+        MX P;  // dense block of the objective
+        std::vector<int> irow;  // inequality rows of A inside this segment
+        MX AI;  // those rows restricted to the segment
+        MX W;  // condensed Hessian P + AI' S AI + Sx
+        Eigen::LLT<MX> llt;
+    };
+    struct Block{
+        std::vector<int> row;  // equality rows whose first column lies in segment b
+        MX F, G;  // those rows restricted to segment b and b + 1
+        MX V, U;  // W_b^-1 F', W_{b+1}^-1 G'
+        Eigen::LLT<MX> llt;  // diagonal block of the Cholesky factor of the Schur complement
+        MX L;  // block below the diagonal, L_{b+1,b}
+    };
+    std::vector<Segment> segs;
+    std::vector<Block> blocks;
+    std::vector<char> is_eq;  // equality flag of each row of A
+
+    // inequality data over the rows of [A; I], has_l and has_u mark finite bounds
+    VX lo, up, sl, su, zl, zu;
+    std::vector<char> has_l, has_u;
+    VX y;  // multipliers of the equality rows, stored over all rows of A
+
+    bool analyze(const SpMX &P, const SpMX &A, cRefVX clb, cRefVX cub, cRefVX xlb, cRefVX xub);
+    VX mult_P(cRefVX v) const;
+    bool regularized_llt(const MX &M, Eigen::LLT<MX> &llt) const;
+    bool factorize(cRefVX sigma);
+    void solve_kkt(cRefVX r1, cRefVX r2, RefVX dx, RefVX dy) const;
+    void solve_kkt_refined(const SpMX &A, cRefVX r1, cRefVX r2, RefVX dx, RefVX dy) const;
+};
+
+#endif /* !BANDED_IPM_H */
@@ -0,0 +1,52 @@
+/*
+ * batch_planner.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef BATCH_PLANNER_H
+#define BATCH_PLANNER_H
+
+#include <string>
+#include <vector>
+#include <limits>
+
+#include "ott/TGProblem.h"
+#include "ott/pybind_box_type.h"
+#include "ott/time_allocator.h"
+
+
+struct BatchOptions{
+    TimeAllocatorSettings settings;  // includes the per-call print level
+    QPSettings qp_settings;
+    int num_threads = 0;  // 0 uses every core
+    bool refine = true;  // refine the time allocation, otherwise only solve with the given times
+};
+
+
+// outcome of one problem of a batch, same meaning as the members of TimeAllocator
+struct BatchResult{
+    bool is_solved = false;
+    bool is_okay = false;
+    bool converged = false;
+    double initial_obj = std::numeric_limits<double>::infinity();
+    double obj = std::numeric_limits<double>::infinity();
+    VX room_time;
+    VX sol;
+    int major_iteration = 0;
+    int num_prob_solve = 0;
+    std::string converge_reason;
+    double solve_time = 0;  // wall time in seconds spent on this problem, including construction
+    int worker = -1;  // which thread solved it
+    PlannerStats stats;  // timers only if options.settings.collect_stats
+};
+
+
+/* Solve many problems at once on a work stealing pool, one TimeAllocator per problem.
+ * Every problem has to use the trajectoryOrder matching MQM (MQM is (order + 1) x (order + 1)).
+ * Nothing here touches Python so the binding releases the GIL while it runs.
+ */
+std::vector<BatchResult> solve_batch(const std::vector<TGProblem> &problems, const MatrixXd &MQM, const BatchOptions &options = BatchOptions());
+
+#endif /* !BATCH_PLANNER_H */
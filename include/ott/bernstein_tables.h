@@ -0,0 +1,64 @@
+/*
+ * bernstein_tables.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef BERNSTEIN_TABLES_H
+#define BERNSTEIN_TABLES_H
+
+#include <cstdint>
+
+
+// highest polynomial order Bernstein supports, 20! is the largest factorial in an int64_t
+const int BEZIER_MAX_ORDER = 20;
+
+
+/* Exact integer tables behind the Bernstein basis, built by the compiler.
+ * binomial[n][k] is n choose k up to n = 2 BEZIER_MAX_ORDER for the products of two Bernstein polynomials, and
+ * falling[n][r] = n! / (n - r)!, the factor d^r/ds^r s^n brings down, 0 for r > n.
+ */
+struct BernsteinTables{
+    int64_t binomial[2 * BEZIER_MAX_ORDER + 1][2 * BEZIER_MAX_ORDER + 1];
+    int64_t falling[BEZIER_MAX_ORDER + 1][BEZIER_MAX_ORDER + 1];
+
+    constexpr BernsteinTables() : binomial(), falling(){
+        for(int n = 0; n <= 2 * BEZIER_MAX_ORDER; n++){
+            binomial[n][0] = 1;
+            for(int k = 1; k <= n; k++)
+                binomial[n][k] = binomial[n - 1][k - 1] + (k < n ? binomial[n - 1][k] : 0);
+        }
+        for(int n = 0; n <= BEZIER_MAX_ORDER; n++){
+            falling[n][0] = 1;
+            for(int r = 1; r <= n; r++)
+                falling[n][r] = falling[n][r - 1] * (n - r + 1);
+        }
+    }
+};
+
+constexpr BernsteinTables BERNSTEIN_TABLES{};
+
+
+/* Entry (i, j) of the matrix mapping the control points of an order n Bezier curve to its monomial coefficients in
+ * s in [0, 1], the coefficient of s^i from control point j: (-1)^(i - j) C(n, i) C(i, j) for j <= i.
+ */
+constexpr int64_t bernstein_m(int n, int i, int j){
+    return j > i ? 0 : ((i - j) % 2 ? -1 : 1) * BERNSTEIN_TABLES.binomial[n][i] * BERNSTEIN_TABLES.binomial[i][j];
+}
+
+/* Integral over [0, 1] of the product of the Bernstein polynomials i and j of order m,
+ * C(m, i) C(m, j) / ((2m + 1) C(2m, i + j)).
+ */
+constexpr double bernstein_gram(int m, int i, int j){
+    return double(BERNSTEIN_TABLES.binomial[m][i] * BERNSTEIN_TABLES.binomial[m][j]) /
+           double((2 * m + 1) * BERNSTEIN_TABLES.binomial[2 * m][i + j]);
+}
+
+static_assert(BERNSTEIN_TABLES.binomial[40][20] == 137846528820LL, "binomial table");
+static_assert(BERNSTEIN_TABLES.binomial[20][10] == 184756, "binomial table");
+static_assert(BERNSTEIN_TABLES.falling[20][20] == 2432902008176640000LL, "factorial table");
+static_assert(bernstein_m(7, 2, 1) == -42 && bernstein_m(7, 2, 2) == 21, "order 7 mapping matrix");
+static_assert(bernstein_m(12, 8, 4) == 34650, "order 12 mapping matrix");
+
+#endif /* !BERNSTEIN_TABLES_H */
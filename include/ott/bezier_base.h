@@ -1,11 +1,13 @@
 /*
 This header file is used to provide some basic mathematic support for the Bernstein-basis trajectory generation optimization problem. Includes:
-1-: Mapping matrix maps the coefficients of the Bernstein basis (ie. control points) to Monomial basis. The mapping matrix range from order 3 to order 10
+1-: Mapping matrix maps the coefficients of the Bernstein basis (ie. control points) to Monomial basis. The mapping matrix range from order 0 to order BEZIER_MAX_ORDER (20),
+	built from the exact integer tables of bernstein_tables.h
 2-: Modulus list of the Bernstein basis to a given order. That is, pre-compute the constant-modulus (the 'n choose k' combinatorial) of the basis vector. 
 	To save computation cost of frequently call this value. 
 
 The class should be initialized to a instance before the trajectory generator called. 
 Several initializer are provided, and the instance is initialized according to the given order of the control points.
+Only the orders from poly_order_min to poly_order_max are computed, the lists are indexed by order and empty below poly_order_min.
 */
 
 #ifndef _BEZIER_BASE_H_
@@ -17,6 +19,8 @@ Several initializer are provided, and the instance is initialized according to t
 #include <Eigen/Dense>
 #include <vector>
 
+#include "ott/bernstein_tables.h"
+
 using namespace std;
 using namespace Eigen;
 
@@ -0,0 +1,85 @@
+/*
+ * constraint_matrix.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef CONSTRAINT_MATRIX_H
+#define CONSTRAINT_MATRIX_H
+
+#include <vector>
+
+#include "ott/pybind_box_type.h"
+#include "ott/qp_solver.h"
+#include "ott/problem_workspace.h"
+
+
+/* The linear constraints of construct_A_matrix with a fixed sparsity pattern.
+ * Every nonzero is coef * t_k^power with power in {-1, 0, 1} and t_k the time of the segment owning the column,
+ * every variable bound is (box +- margin) / t_k and the constraint bounds do not depend on time.
+ * The pattern and these coefficients are computed once, update_times then rewrites values and bounds in place,
+ * in the compressed column arrays of lincon and in the matrix A.
+ * The model is checked on the two builds at construction, if construct_A_matrix does not follow it every update assembles
+ * the whole matrix again.
+ */
+class ConstraintMatrix{
+public:
+    LinearConstr lincon;  // matrix and bounds at the current times, same layout as construct_A_matrix
+    SpMX A;  // lincon as an Eigen matrix, its values are in the order of lincon.values
+
+    ConstraintMatrix(){}
+
+    ConstraintMatrix(
+            const vector<pyBox> &corridor,
+            const MatrixXd &MQM,
+            const MatrixXd &pos,
+            const MatrixXd &vel,
+            const MatrixXd &acc,
+            const double maxVel,
+            const double maxAcc,
+            const int traj_order,
+            const double minimize_order,
+            const double margin,
+            const bool & isLimitVel,
+            const bool & isLimitAcc,
+            ProblemWorkspace *ws = nullptr);  // buffers for the assembly, a temporary one if not given
+
+    // refresh values and variable bounds for new segment times
+    void update_times(cRefVX room_time);
+
+    /* Derivatives of A and of the variable bounds along a change dtime of room_time, dA has the pattern of A.
+     * Returns false if the constraints do not follow the model above.
+     */
+    bool time_derivative(cRefVX room_time, cRefVX dtime, SpMX &dA, VX &dxlb, VX &dxub) const;
+
+    int num_segment() const {return n_seg;}
+
+    // true if the values do not follow the model above and update_times assembles them in full
+    bool is_reassembled() const {return reassemble;}
+
+private:
+    int n_seg = 0;
+    int s1CtrlP_num = 0;  // number of variables of a segment
+    // per nonzero in the order of lincon.values and A.valuePtr()
+    std::vector<int> seg;  // segment of each nonzero
+    std::vector<int> power;  // exponent of t_k of each nonzero
+    std::vector<double> coef;  // value of each nonzero when t_k = 1
+    VX xlb0, xub0;  // variable bounds when every t_k = 1
+    VX inv_time;  // kept so that update_times does not allocate
+
+    // arguments of construct_A_matrix, only kept if the values do not follow the model
+    struct AssemblyInputs{
+        vector<pyBox> corridor;
+        MatrixXd MQM, pos, vel, acc;
+        double maxVel = 0, maxAcc = 0;
+        int traj_order = 0;
+        double minimize_order = 0, margin = 0;
+        bool isLimitVel = false, isLimitAcc = false;
+        ProblemWorkspace work;
+    };
+    bool reassemble = false;
+    AssemblyInputs inputs;
+};
+
+#endif /* !CONSTRAINT_MATRIX_H */
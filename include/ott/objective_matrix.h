@@ -0,0 +1,48 @@
+/*
+ * objective_matrix.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef OBJECTIVE_MATRIX_H
+#define OBJECTIVE_MATRIX_H
+
+#include <string>
+#include <vector>
+
+#include "ott/pybind_box_type.h"
+#include "ott/qp_solver.h"
+
+
+/* The objective of construct_P_matrix kept in compressed column form.
+ * P is block diagonal and the block of segment k is MQM times a scalar of room_time(k), so the columns of
+ * a segment are contiguous in the value array and update_times rescales each of them with one multiply.
+ */
+class ObjectiveMatrix{
+public:
+    SpMX P;  // chosen triangle ("L", "U" or "F" as in construct_P_matrix)
+
+    ObjectiveMatrix(){}
+
+    ObjectiveMatrix(double minimize_order, int segment_num, int poly_order, cRefVX room_time, cRefMX MQM, const std::string &type = "L");
+
+    // rescale every segment block for new segment times
+    void update_times(cRefVX room_time);
+
+    // derivative of P along a change dtime of room_time, it has the pattern of P
+    SpMX time_derivative(cRefVX room_time, cRefVX dtime) const;
+
+    // the scalar multiplying MQM in the block of a segment with time t
+    static double segment_scale(double minimize_order, double t);
+
+    int num_segment() const {return n_seg;}
+
+private:
+    double minimize_order = 3;
+    int n_seg = 0;
+    VX base_val;  // values of P when every time is 1, i.e. MQM repeated
+    std::vector<int> seg_begin;  // value index where each segment starts, n_seg + 1 of them
+};
+
+#endif /* !OBJECTIVE_MATRIX_H */
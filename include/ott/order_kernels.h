@@ -0,0 +1,44 @@
+/*
+ * order_kernels.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef ORDER_KERNELS_H
+#define ORDER_KERNELS_H
+
+#include "ott/pybind_box_type.h"
+
+
+// multiplier of MQM in the objective block of a segment with time t, and its derivative with respect to t
+struct TimeScale{
+    double val;
+    double dvdt;
+};
+
+TimeScale time_scale(double minimize_order, double t);
+
+
+/* Objective kernels of one trajectory order.
+ * Orders 5 to 8 are instantiated with fixed size Eigen blocks so the (order + 1) x (order + 1) products unroll,
+ * any other order goes to the generic dynamic size version. n_poly = traj_order + 1 is passed to all of them and
+ * only the generic one reads it. Only the leading n_poly x n_poly block of MQM is used.
+ */
+struct OrderKernels{
+    int traj_order;  // -1 for the generic kernels
+
+    // the cost and, if needg, its gradient with respect to coef followed by room_time, as cost_eval_with_grad
+    double (*cost_with_grad)(int n_poly, cRefVX coef, cRefVX room_time, double minimize_order, cRefMX MQM, RefVX G, bool needg);
+
+    // derivative of the cost at sol with respect to each room_time, as gradient_from_P
+    void (*gradient_from_P)(int n_poly, cRefVX room_time, double minimize_order, cRefMX MQM, cRefVX sol, RefVX pgrad);
+
+    // triplets of the objective with type 'L', 'U' or 'F' in the order of construct_P_matrix
+    void (*fill_P)(int n_poly, cRefVX room_time, double minimize_order, cRefMX MQM, char type, RefVX qval, ReflVX qsubi, ReflVX qsubj);
+};
+
+// look up the kernels of an order, falls back to the generic ones outside 5 to 8
+const OrderKernels &order_kernels(int traj_order);
+
+#endif /* !ORDER_KERNELS_H */
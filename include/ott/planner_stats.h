@@ -0,0 +1,67 @@
+/*
+ * planner_stats.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef PLANNER_STATS_H
+#define PLANNER_STATS_H
+
+#include <chrono>
+
+
+/* Where the time of a TimeAllocator goes, accumulated since its construction or the last reset.
+ * Counters and sizes are always kept, they are a few integer increments per solve. The timers read the clock only
+ * if TimeAllocatorSettings::collect_stats is set. Times are in seconds.
+ */
+struct PlannerStats{
+    // size of the QP
+    int n_var = 0, n_con = 0;
+    int nnz_P = 0, nnz_A = 0;
+
+    int n_assembly = 0;  // objective and constraint values rewritten for new times
+    int n_solve = 0;  // QP solves, including line search trials solved ahead and finite difference solves
+    int n_solve_failed = 0;
+    int n_gradient = 0;  // analytic gradients
+    int n_trial = 0;  // line search trials looked at
+    int n_rejected = 0;  // of those, the ones that failed to solve or did not decrease the cost enough
+    int n_workspace_alloc = 0;  // growths of the buffers of a shared ProblemWorkspace at construction, see num_alloc
+    int n_analyze = 0, n_factorize = 0;  // symbolic and numeric factorizations of QPSolver, as analyze_count
+
+    double t_assembly = 0;
+    double t_solve = 0;
+    double t_gradient = 0;  // analytic and finite difference gradients
+    double t_line_search = 0;  // everything between two gradients, trials included
+    double t_refine = 0;  // whole calls to refine_time_by_backtrack
+
+    // zero counters and timers, the sizes stay
+    void reset(){
+        PlannerStats fresh;
+        fresh.n_var = n_var;
+        fresh.n_con = n_con;
+        fresh.nnz_P = nnz_P;
+        fresh.nnz_A = nnz_A;
+        *this = fresh;
+    }
+};
+
+
+// adds the time between construction and destruction to *acc, with a null acc it does nothing
+class ScopedStatTimer{
+public:
+    explicit ScopedStatTimer(double *acc_) : acc(acc_){
+        if(acc)
+            t0 = std::chrono::steady_clock::now();
+    }
+    ~ScopedStatTimer(){
+        if(acc)
+            *acc += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    }
+
+private:
+    double *acc;
+    std::chrono::steady_clock::time_point t0;
+};
+
+#endif /* !PLANNER_STATS_H */
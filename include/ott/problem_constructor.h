@@ -0,0 +1,152 @@
+/*
+ * problem_constructor.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef PROBLEM_CONSTRUCTOR_H
+#define PROBLEM_CONSTRUCTOR_H
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ott/pybind_box_type.h"
+#include "ott/problem_workspace.h"
+
+
+// print level of the calling thread
+void set_print_level(int level);
+
+int get_print_level();
+
+// subroutines for problem construction
+std::tuple<VX, lVX, lVX> construct_P_matrix(double minimize_order, int segment_num, int poly_order, RefVX room_time, RefMX MQM, std::string &type);
+
+VX gradient_from_P(double minimize_order, int segment_num, int poly_order, cRefVX room_time, cRefMX MQM, cRefVX sol);
+
+LinearConstr construct_A_matrix(
+    const vector<pyBox> &corridor,
+    const MatrixXd &MQM,
+    const MatrixXd &pos,
+    const MatrixXd &vel,
+    const MatrixXd &acc,
+    const double maxVel,
+    const double maxAcc,
+    const int traj_order,
+    const double minimize_order,
+    const double margin,
+    const bool & isLimitVel,
+    const bool & isLimitAcc);
+
+// same as construct_A_matrix but assembles into the buffers of ws, so repeated calls do not allocate
+const LinearConstr &assemble_A_matrix(
+    ProblemWorkspace &ws,
+    const vector<pyBox> &corridor,
+    const MatrixXd &MQM,
+    const MatrixXd &pos,
+    const MatrixXd &vel,
+    const MatrixXd &acc,
+    const double maxVel,
+    const double maxAcc,
+    const int traj_order,
+    const double minimize_order,
+    const double margin,
+    const bool & isLimitVel,
+    const bool & isLimitAcc);
+
+VX gradient_from_A(
+            const vector<pyBox> &corridor,
+            const MatrixXd &MQM,
+            const MatrixXd &pos,
+            const MatrixXd &vel,
+            const MatrixXd &acc,
+            const double maxVel,
+            const double maxAcc,
+            const int traj_order,
+            const double minimize_order,
+            const double margin,
+            const bool & isLimitVel,
+            const bool & isLimitAcc,
+            cRefVX sol,
+            cRefVX lmdy,  //lmdy is for constraints
+            cRefVX lmdz  // lmdz is for bounds on variables
+        );
+
+// same as gradient_from_A but computes into the buffers of ws and returns them, so repeated calls do not allocate
+const VX &gradient_from_A(
+            ProblemWorkspace &ws,
+            const vector<pyBox> &corridor,
+            const MatrixXd &MQM,
+            const MatrixXd &pos,
+            const MatrixXd &vel,
+            const MatrixXd &acc,
+            const double maxVel,
+            const double maxAcc,
+            const int traj_order,
+            const double minimize_order,
+            const double margin,
+            const bool & isLimitVel,
+            const bool & isLimitAcc,
+            cRefVX sol,
+            cRefVX lmdy,
+            cRefVX lmdz
+        );
+
+
+std::pair<int, int> snopt_eval(
+            const vector<pyBox> &corridor,
+            const MatrixXd &MQM,
+            const MatrixXd &pos,
+            const MatrixXd &vel,
+            const MatrixXd &acc,
+            const double maxVel,
+            const double maxAcc,
+            const int traj_order,
+            const double minimize_order,
+            const double margin,
+            const bool & isLimitVel,
+            const bool & isLimitAcc,
+            cRefVX coef,  // the coefficients
+            RefVX F,  // records actual function values
+            RefVX lb,  // records lower bound since previous one does not apply
+            RefVX ub,  // records upper bound since previous one does not apply
+            RefVX G,  // record gradients, treat all things nonlinear
+            ReflVX row,  // record rows of gradients
+            ReflVX col,  // record cols of gradients
+            bool needg,  // enable recording of G
+            bool rec,
+            bool needlub  // enable recording of lb and ub
+        );
+
+// same as snopt_eval but keeps its temporaries in ws, so repeated calls do not allocate
+std::pair<int, int> snopt_eval(
+            ProblemWorkspace &ws,
+            const vector<pyBox> &corridor,
+            const MatrixXd &MQM,
+            const MatrixXd &pos,
+            const MatrixXd &vel,
+            const MatrixXd &acc,
+            const double maxVel,
+            const double maxAcc,
+            const int traj_order,
+            const double minimize_order,
+            const double margin,
+            const bool & isLimitVel,
+            const bool & isLimitAcc,
+            cRefVX coef,
+            RefVX F,
+            RefVX lb,
+            RefVX ub,
+            RefVX G,
+            ReflVX row,
+            ReflVX col,
+            bool needg,
+            bool rec,
+            bool needlub
+        );
+
+std::pair<double, VX> eval_f(cRefVX coef, cRefVX room_time, int traj_order, double minimize_order, cRefMX MQM, bool needg);
+
+#endif /* !PROBLEM_CONSTRUCTOR_H */
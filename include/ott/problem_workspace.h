@@ -0,0 +1,66 @@
+/*
+ * problem_workspace.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef PROBLEM_WORKSPACE_H
+#define PROBLEM_WORKSPACE_H
+
+#include "ott/pybind_box_type.h"
+
+
+// exact row and nonzero counts of the problem built by construct_A_matrix
+struct ProblemSize{
+    int segment_num = 0;
+    int traj_order = 0;
+    bool limit_vel = false;
+    bool limit_acc = false;
+
+    int n_var = 0;
+    int vel_con_num = 0;  // velocity limit rows, 2 nonzeros each
+    int acc_con_num = 0;  // acceleration limit rows, 3 nonzeros each
+    int equ_con_num = 0;  // p, v, a in x, y, z axis at start, end and each joint
+    int n_con = 0;
+    int n_nnz = 0;
+
+    ProblemSize(){}
+    ProblemSize(int segment_num_, int traj_order_, bool limit_vel_, bool limit_acc_);
+
+    bool same_shape(const ProblemSize &other) const {
+        return segment_num == other.segment_num && traj_order == other.traj_order
+            && limit_vel == other.limit_vel && limit_acc == other.limit_acc;
+    }
+};
+
+
+/* Buffers for assembling the problem, for gradient_from_A and for snopt_eval that are sized exactly once per problem
+ * shape and reused afterwards. num_alloc counts the times these buffers had to grow, so after the first call with a
+ * given shape it should not move. ott_regression counts the heap allocations of the three calls themselves.
+ */
+class ProblemWorkspace{
+public:
+    ConstraintTape con_tape;
+    ConstraintTape var_tape;
+    LinearConstr lincon;
+    VX grad;  // output of gradient_from_A, one entry per segment
+    VX times;  // segment times taken from the corridor by snopt_eval
+    size_t num_alloc = 0;
+
+    ProblemWorkspace(){}
+
+    // make sure the buffers fit this shape and clear the tapes, grad and times are left unset
+    void prepare(int segment_num, int traj_order, bool isLimitVel, bool isLimitAcc);
+
+    // copy the tapes into lincon and account for any growth of the buffers
+    void finish();
+
+    const ProblemSize &size() const {return shape;}
+
+private:
+    ProblemSize shape;
+    size_t capacity_con = 0, capacity_nnz = 0, capacity_var = 0;
+};
+
+#endif /* !PROBLEM_WORKSPACE_H */
@@ -41,6 +41,26 @@ public:
         n_bound += 1;
     }
 
+    // start over but keep the memory
+    void clear(){
+        row.clear();
+        col.clear();
+        val.clear();
+        lb.clear();
+        ub.clear();
+        n_bound = 0;
+        a_nnz = 0;
+        a_row = 0;
+    }
+
+    void reserve(size_t num_bound, size_t num_nnz){
+        lb.reserve(num_bound);
+        ub.reserve(num_bound);
+        row.reserve(num_nnz);
+        col.reserve(num_nnz);
+        val.reserve(num_nnz);
+    }
+
     void putarow(int row_idx, int nzi, int *asub, double *aval){
         for(int i = 0; i < nzi; i++){
             row.push_back(row_idx);
@@ -56,37 +76,46 @@ public:
 class LinearConstr{
 public:
     VX xlb, xub, clb, cub;
-    VX aval;
-    lVX arow, acol;
+    // the constraint matrix in compressed column form, rows sorted within a column, ready for scipy and mosek
+    VX values;
+    lVX rowind, colptr;
     size_t n_var, n_con, n_nnz;
 
     LinearConstr(){}
 
     LinearConstr(ConstraintTape &con_tape, ConstraintTape &var_tape){
+        assign(con_tape, var_tape);
+    }
+
+    // convert the tapes, the buffers are only reallocated if the sizes change
+    void assign(ConstraintTape &con_tape, ConstraintTape &var_tape){
         n_var = var_tape.lb.size();
-        xlb = VX::Zero(n_var);
-        xub = xlb;
-        for(size_t i = 0; i < n_var; i++){
-            xlb(i) = var_tape.lb[i];
-            xub(i) = var_tape.ub[i];
-        }
         n_con = con_tape.lb.size();
         n_nnz = con_tape.val.size();
         //std::cout << "var " << n_var << " con " << n_con << " nnz " << n_nnz << std::endl;
-        clb = VX::Zero(n_con);
-        cub = VX::Zero(n_con);
-        aval = VX::Zero(n_nnz);
-        arow = lVX::Zero(n_nnz);
-        acol = lVX::Zero(n_nnz);
-        for(size_t i = 0; i < n_con; i++){
-            clb(i) = con_tape.lb[i];
-            cub(i) = con_tape.ub[i];
-        }
+        xlb = MapVX(var_tape.lb.data(), n_var);
+        xub = MapVX(var_tape.ub.data(), n_var);
+        clb = MapVX(con_tape.lb.data(), n_con);
+        cub = MapVX(con_tape.ub.data(), n_con);
+
+        // bucket the triplets by column, rows are put in increasing order so each column comes out sorted
+        colptr.resize(n_var + 1);
+        colptr.setZero();
+        for(size_t i = 0; i < n_nnz; i++)
+            colptr(con_tape.col[i] + 1) += 1;
+        for(size_t j = 0; j < n_var; j++)
+            colptr(j + 1) += colptr(j);
+        values.resize(n_nnz);
+        rowind.resize(n_nnz);
+        // colptr(j) is used as the insertion point of column j and ends up at the start of column j + 1
         for(size_t i = 0; i < n_nnz; i++){
-            arow(i) = con_tape.row[i];
-            acol(i) = con_tape.col[i];
-            aval(i) = con_tape.val[i];
+            int dst = colptr(con_tape.col[i])++;
+            rowind(dst) = con_tape.row[i];
+            values(dst) = con_tape.val[i];
         }
+        for(size_t j = n_var; j > 0; j--)
+            colptr(j) = colptr(j - 1);
+        colptr(0) = 0;
     }
 };
 
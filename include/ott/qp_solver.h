@@ -0,0 +1,176 @@
+/*
+ * qp_solver.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef QP_SOLVER_H
+#define QP_SOLVER_H
+
+#include <vector>
+#include <eigen3/Eigen/Dense>
+#include <eigen3/Eigen/Sparse>
+
+#include "ott/pybind_box_type.h"
+
+typedef Eigen::SparseMatrix<double> SpMX;  // column major, this is what the KKT solvers want
+
+
+// status of a QP solve, positive means we have a usable solution
+enum QPStatus{
+    QP_SOLVED = 1,
+    QP_UNSOLVED = 0,
+    QP_MAX_ITER_REACHED = -2,
+    QP_PRIMAL_INFEASIBLE = -3,
+    QP_NON_CVX = -7,
+    QP_INVALID_DATA = -9  // the problem does not have the structure a solver relies on
+};
+
+
+struct QPSettings{
+    double rho = 0.1;  // initial ADMM step size
+    double sigma = 1e-6;  // regularization on x
+    double alpha = 1.6;  // over-relaxation
+    double eps_abs = 1e-7;  // tight so the polished active set is right and the multipliers give good gradients
+    double eps_rel = 1e-7;
+    double eps_prim_inf = 1e-6;
+    int max_iter = 10000;
+    int check_interval = 5;  // how often we evaluate residuals
+    int scaling_iter = 0;  // Ruiz equilibration passes, off since it slows ADMM down on our corridors, see ott_regression
+    bool adaptive_rho = true;
+    double adaptive_rho_tolerance = 5;
+    int adaptive_rho_interval = 25;
+    bool polish = true;  // solve the equality QP on the guessed active set after ADMM
+    int polish_interval = 50;  // also try it every so many iterations and stop early if it is accurate, 0 to disable
+    double polish_delta = 1e-7;
+    int polish_refine_iter = 25;
+    bool warm_start = true;
+    bool active_set_fast_path = true;  // first try the active set of the previous solution with a few KKT solves
+    int active_set_updates = 3;  // corrections of that active set before giving up and running ADMM
+};
+
+
+/* SimplicialLDLT that keeps its symbolic analysis (fill reducing ordering and elimination tree) as long as the sparsity
+ * pattern of the matrix does not change, so a new factorization after the values change is numeric only.
+ * For a fixed corridor the patterns of P and A never change, only the values scale with room_time, so one analysis
+ * serves every rho update and every line search trial. SimplicialLDLT can not be copied, a copy starts empty.
+ */
+class CachedLDLT : public Eigen::SimplicialLDLT<SpMX, Eigen::Lower>{
+public:
+    int n_analyze = 0, n_factorize = 0;
+
+    CachedLDLT(){}
+    CachedLDLT(const CachedLDLT &){}
+    CachedLDLT &operator=(const CachedLDLT &){return *this;}
+
+    // factorize K, only its lower triangle is read, the pattern is analyzed again only if it differs from the last one
+    bool factorize_cached(const SpMX &K);
+
+private:
+    std::vector<int> outer, inner;  // pattern of the last analyzed matrix
+};
+
+
+/* An ADMM (OSQP-style) solver for
+ *     min 0.5 x'Px + q'x  s.t.  clb <= Ax <= cub,  xlb <= x <= xub
+ * Only the lower triangle of P is read, so the output of construct_P_matrix with type "L" (or "F") works.
+ * Dual variables follow the mosek convention used by gradient_from_A, i.e. Px + q + A'lmdy + lmdz = 0 with
+ * lmdy > 0 (lmdz > 0) when the upper bound of a constraint (variable) is active.
+ * The last iterate is kept so the next solve is warm started even if the matrix values change, and before running
+ * ADMM the next solve tries the active set of that iterate directly.
+ */
+class QPSolver{
+public:
+    QPSettings settings;
+
+    // results of the last solve, NaN unless it succeeded
+    VX x, lmdy, lmdz;
+    double obj = 0;
+    int status = QP_UNSOLVED;
+    int iter = 0;
+    bool polished = false;
+    bool active_set_hit = false;  // solved on the previous active set without running ADMM
+    double prim_res = 0, dual_res = 0;
+
+    // outcomes of the active set fast path since construction
+    int active_set_hits = 0, active_set_misses = 0;
+    int warm_start_accepts = 0;  // solves where the warm start was already a solution
+
+    QPSolver(){}
+    QPSolver(const QPSettings &settings_) : settings(settings_){}
+
+    int solve(const SpMX &P, cRefVX q, const SpMX &A, cRefVX clb, cRefVX cub, cRefVX xlb, cRefVX xub);
+
+    // solve directly from the output of construct_P_matrix and construct_A_matrix
+    int solve_triplets(cRefVX pval, const lVX &prow, const lVX &pcol, const LinearConstr &lincon);
+
+    // forget the previous iterate so next solve starts cold
+    void reset();
+
+    /* Take over the last solve of other: its results and what the next warm start and sensitivity use. The settings,
+     * the counters and the cached factorizations of this solver stay.
+     */
+    void take_solution(const QPSolver &other);
+
+    // the counters below and those of analyze_count and factorize_count, e.g. for solves run on a copy of this solver
+    void reset_counters();
+    void add_counters(const QPSolver &other);
+
+    // replace the previous iterate, e.g. by a predicted solution, z and y are over the rows of [A; I]; the next solve
+    // accepts it if it already is a solution, otherwise starts the active set fast path and ADMM from it
+    void set_warm_start(cRefVX x_w, cRefVX z_w, cRefVX y_w);
+
+    // everything the next solve starts from, so several solves can start from the same point whatever ran in between
+    struct WarmStart{
+        VX x, z, y;
+        double rho = 0.1;
+    };
+    WarmStart get_warm_start() const;
+    void restore_warm_start(const WarmStart &ws);
+
+    /* Directional derivatives of the last solution x, lmdy and lmdz, given those of the data P (lower triangle), q, A and
+     * the bounds, from the KKT system on its active set. Valid as long as the active set does not change.
+     * Returns false if the last solve did not succeed or the factorization fails.
+     */
+    bool sensitivity(const SpMX &dP, cRefVX dq, const SpMX &dA, cRefVX dclb, cRefVX dcub, cRefVX dxlb, cRefVX dxub,
+                     VX &dx, VX &dlmdy, VX &dlmdz);
+
+    bool is_solved() const {return status > 0;}
+
+    // symbolic and numeric factorizations since construction, of both the ADMM and the polish systems
+    int analyze_count() const {return ldlt.n_analyze + polish_ldlt.n_analyze;}
+    int factorize_count() const {return ldlt.n_factorize + polish_ldlt.n_factorize;}
+
+private:
+    int n = 0, m = 0;  // number of variables, number of rows of [A; I]
+    SpMX Ps, Cs;  // scaled objective (full symmetric) and constraint matrix [A; I]
+    VX qs, ls, us;
+    VX D, E;  // variable and constraint scaling
+    double c = 1;  // cost scaling
+    VX rho_vec;
+    double rho = 0.1;
+    VX xs, zs, ys;  // scaled iterates
+    CachedLDLT ldlt;
+    CachedLDLT polish_ldlt;  // the active set usually repeats between solves, and then so does the pattern
+
+    // warm start, stored unscaled
+    VX x_prev, z_prev, y_prev;
+
+    void scale_data(const SpMX &P, cRefVX q, const SpMX &C, cRefVX l, cRefVX u);
+    void set_rho_vec();
+    bool factorize();
+    void residuals(cRefVX xv, cRefVX zv, cRefVX yv, double &prim, double &dual, double &eps_prim, double &eps_dual) const;
+    bool is_primal_infeasible(cRefVX dy) const;
+    bool solve_equality_qp(const std::vector<int> &side, cRefVX rx, cRefVX rb, VX &x_eq, VX &y_eq);
+    VX active_bounds(const std::vector<int> &side, cRefVX lower, cRefVX upper) const;
+    std::vector<int> active_side(cRefVX y) const;
+    bool wrong_sign(int side, int i, double yi) const;
+    bool polish_solution(bool require_tol);
+    bool solve_previous_active_set();
+    bool accept_warm_start();
+    void unscale_solution(int n_con);
+    void clear_solution(int n_con);
+};
+
+#endif /* !QP_SOLVER_H */
@@ -0,0 +1,78 @@
+/*
+ * receding_horizon.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef RECEDING_HORIZON_H
+#define RECEDING_HORIZON_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ott/TGProblem.h"
+#include "ott/pybind_box_type.h"
+#include "ott/problem_workspace.h"
+#include "ott/time_allocator.h"
+
+
+/* Replanning along a corridor that moves with the vehicle, at a rate of 10 to 20 Hz.
+ * Between two calls of replan the boxes already flown through are dropped at the front, new ones are appended at the
+ * tail and the start state is set from odometry. replan then solves the new corridor starting from the last plan:
+ * the kept boxes keep their refined times, and the QP is warm started with the kept segments of the last solution and
+ * the multipliers of the constraints that still exist, so the active set of the last plan is tried first.
+ */
+class RecedingHorizonPlanner{
+public:
+    TimeAllocatorSettings settings;
+    QPSettings qp_settings;
+
+    RecedingHorizonPlanner(const TGProblem &tgp, const MatrixXd &MQM_, const TimeAllocatorSettings &settings_ = TimeAllocatorSettings());
+
+    // remove the first n boxes, at least one has to stay
+    bool drop_front(int n);
+
+    // add boxes after the last one, a box whose t is not positive gets the mean time of the current boxes
+    void append_boxes(const std::vector<pyBox> &boxes);
+
+    // position, velocity and acceleration at the start of the first box, and at the end of the last one
+    void set_start_state(const Eigen::Vector3d &pos, const Eigen::Vector3d &vel, const Eigen::Vector3d &acc);
+    void set_end_state(const Eigen::Vector3d &pos, const Eigen::Vector3d &vel, const Eigen::Vector3d &acc);
+
+    /* Solve the current corridor and refine its times, returns is_okay, converged as refine_time_by_backtrack.
+     * On success the refined times are written back into the boxes and the solution becomes the new plan,
+     * otherwise the last plan is kept for the next call.
+     */
+    std::pair<bool, bool> replan();
+
+    const TGProblem &problem() const {return tgp;}
+    int num_box() const {return tgp.corridor.size();}
+    bool has_plan() const {return plan.valid;}
+
+    // the allocator of the last replan, holding its solution, times and stats; null before the first one
+    const TimeAllocator *allocator() const {return last.get();}
+
+    int num_replan = 0;
+    int num_warm_start = 0;  // replans started from a previous plan
+
+private:
+    TGProblem tgp;
+    MatrixXd MQM;
+    ProblemWorkspace ws;  // assembly buffers reused by every replan
+    std::unique_ptr<TimeAllocator> last;
+
+    // the last successful solution, its segments are shifted by the boxes dropped since
+    struct Plan{
+        bool valid = false;
+        int num_seg = 0;
+        int shift = 0;
+        VX sol, lmdy, lmdz;
+        std::vector<std::vector<int> > row_keys;  // which constraint each row of lmdy is, see constraint_row_keys
+    } plan;
+
+    void warm_start(TimeAllocator &allocator) const;
+};
+
+#endif /* !RECEDING_HORIZON_H */
@@ -0,0 +1,116 @@
+/*
+ * tgp_binary.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef TGP_BINARY_H
+#define TGP_BINARY_H
+
+#include <string>
+#include <stdint.h>
+
+#include "ott/TGProblem.h"
+
+
+/* Binary layout of a TGProblem, an alternative to the Boost text archive that needs no parsing.
+ * A file is a TGPBinaryHeader followed by flat little-endian arrays, each starting at an offset
+ * from the header that is a multiple of 8, so the arrays can be used in place from an mmap.
+ *   bounds   segment_num x 6 row major, (xlo, xhi, ylo, yhi, zlo, zhi) per box, same as Box::box after setBox
+ *   time     segment_num
+ *   center   segment_num x 3 row major
+ *   vertex   segment_num blocks of 8 x 3 column major, same as Box::vertex
+ *   valid    segment_num bytes
+ *   MQM, position, velocity, acceleration column major with the shapes in the header
+ */
+const uint32_t TGP_BINARY_MAGIC = 0x42504754;  // "TGPB" in the file
+const uint32_t TGP_BINARY_VERSION = 1;
+
+enum TGPBinaryFlag{
+    TGP_LIMIT_VELOCITY = 1,
+    TGP_LIMIT_ACCELERATION = 2
+};
+
+struct TGPBinaryHeader{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;  // sizeof(TGPBinaryHeader) of the writer
+    uint32_t segment_num;
+    int32_t trajectory_order;
+    uint32_t flags;
+    uint32_t mqm_rows, mqm_cols;
+    uint32_t pos_rows, pos_cols;
+    uint32_t vel_rows, vel_cols;
+    uint32_t acc_rows, acc_cols;
+    double max_velocity;
+    double max_acceleration;
+    double minimize_order;
+    double margin;
+    uint64_t bounds_offset;
+    uint64_t time_offset;
+    uint64_t center_offset;
+    uint64_t vertex_offset;
+    uint64_t valid_offset;
+    uint64_t mqm_offset;
+    uint64_t pos_offset;
+    uint64_t vel_offset;
+    uint64_t acc_offset;
+    uint64_t file_size;
+};
+
+
+typedef Eigen::Map<const Eigen::Matrix<double, -1, -1, Eigen::RowMajor> > MapRowMX;
+typedef Eigen::Map<const MatrixXd> MapColMX;
+typedef Eigen::Map<const VectorXd> MapCVX;
+
+
+/* Read only view of a binary TGProblem file through mmap.
+ * Nothing is parsed, the accessors point into the mapping and stay valid until close or destruction.
+ */
+class TGProblemView{
+public:
+    TGProblemView(){}
+    explicit TGProblemView(const std::string &fileName){open(fileName);}
+    ~TGProblemView(){close();}
+    TGProblemView(const TGProblemView&) = delete;
+    TGProblemView &operator=(const TGProblemView&) = delete;
+
+    // map a file and check its header and sizes, prints the reason and returns false if it is not usable
+    bool open(const std::string &fileName);
+    void close();
+    bool is_open() const {return data != nullptr;}
+
+    const TGPBinaryHeader &header() const {return *reinterpret_cast<const TGPBinaryHeader*>(data);}
+    int segment_num() const {return header().segment_num;}
+    MapRowMX bounds() const {return MapRowMX(array(header().bounds_offset), segment_num(), 6);}
+    MapCVX times() const {return MapCVX(array(header().time_offset), segment_num());}
+    MapRowMX centers() const {return MapRowMX(array(header().center_offset), segment_num(), 3);}
+    MapColMX vertex(int i) const {return MapColMX(array(header().vertex_offset) + 24 * i, 8, 3);}
+    bool valid(int i) const {return data[header().valid_offset + i] != 0;}
+    MapColMX MQM() const {return MapColMX(array(header().mqm_offset), header().mqm_rows, header().mqm_cols);}
+    MapColMX position() const {return MapColMX(array(header().pos_offset), header().pos_rows, header().pos_cols);}
+    MapColMX velocity() const {return MapColMX(array(header().vel_offset), header().vel_rows, header().vel_cols);}
+    MapColMX acceleration() const {return MapColMX(array(header().acc_offset), header().acc_rows, header().acc_cols);}
+
+    // copy into a TGProblem, the boxes come out with box already set so no setBox is needed
+    void to_problem(TGProblem &problem) const;
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+
+    const double *array(uint64_t offset) const {return reinterpret_cast<const double*>(data + offset);}
+};
+
+
+// write problem in the binary layout, returns false if the file cannot be written
+bool saveTGProblemToBinary(const TGProblem &problem, const std::string &fileName);
+
+// read a binary file written by saveTGProblemToBinary
+bool loadTGProblemFromBinary(const std::string &fileName, TGProblem &problem);
+
+// true if the file starts with the binary magic, used to pick the loader for a path
+bool isTGProblemBinary(const std::string &fileName);
+
+#endif /* !TGP_BINARY_H */
@@ -0,0 +1,61 @@
+/*
+ * thread_pool.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+
+/* Work stealing pool for a batch of independent tasks.
+ * Tasks are dealt round robin into one deque per worker, a worker takes from the front of its own deque and
+ * steals from the back of the others once it runs dry, so a few long problems do not leave cores idle.
+ * The threads are started by the first run that needs them and wait for the next one afterwards, so a pool kept
+ * around costs no thread creation per run. A copy has the same size and threads of its own.
+ */
+class WorkStealingPool{
+public:
+    // 0 means one worker per core
+    explicit WorkStealingPool(int num_threads = 0);
+    WorkStealingPool(const WorkStealingPool &other);
+    WorkStealingPool &operator=(const WorkStealingPool &other);
+    ~WorkStealingPool();
+
+    int num_threads() const {return n_thread;}
+
+    // call fn(task, worker) for every task in [0, num_task) and return when all are done, fn must not run this pool
+    void run(int num_task, const std::function<void(int, int)> &fn);
+
+private:
+    struct TaskQueue{
+        std::mutex lock;
+        std::deque<int> tasks;
+    };
+    int n_thread = 1;
+    std::vector<TaskQueue> queues;
+
+    // workers 1 to n_thread - 1, the calling thread is worker 0
+    std::vector<std::thread> threads;
+    std::mutex state_lock;
+    std::condition_variable wake, done;
+    const std::function<void(int, int)> *job = nullptr;
+    int generation = 0;  // number of runs handed to the threads
+    int n_active = 0;  // workers taking part in the current run
+    int n_busy = 0;  // threads not done with the current run
+    bool stopping = false;
+
+    bool next_task(int worker, int &task);
+    void worker_loop(int worker, int seen);
+    void stop();
+};
+
+#endif /* !THREAD_POOL_H */
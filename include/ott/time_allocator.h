@@ -0,0 +1,193 @@
+/*
+ * time_allocator.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef TIME_ALLOCATOR_H
+#define TIME_ALLOCATOR_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ott/pybind_box_type.h"
+#include "ott/qp_solver.h"
+#include "ott/constraint_matrix.h"
+#include "ott/objective_matrix.h"
+#include "ott/axis_split.h"
+#include "ott/banded_ipm.h"
+#include "ott/planner_stats.h"
+
+
+// the arguments of IndoorOptProblem.refine_time_by_backtrack and its tolerances
+struct TimeAllocatorSettings{
+    double alpha0 = 0.175;  // initial step length, 0.175 and 0.375 are found to be very good
+    double c = 0.2;  // the objective decrease parameter
+    double tau = 0.2;  // the step length shrink parameter
+    int max_iter = 50;  // maximum iteration for gradient descent
+    int j_iter = 5;  // maximum iteration for finding alpha
+    bool adaptive_line_search = false;
+    double abs_obj_tol = 1e-3;
+    double rel_obj_tol = 1e-3;
+    double grad_tol = 1e-3;
+    double tfweight = 0;  // weight on total time, if 0 the total time is fixed
+    bool log = false;  // record objective and duration of each major iteration
+    bool split_axes = false;  // solve x, y, z as three separate QPs, see AxisSplitQP
+    bool banded_ipm = false;  // solve with BandedIPMSolver, linear in the number of segments, takes precedence over split_axes
+    bool predict_solution = true;  // start each line search trial from the first order prediction along the search direction
+    int line_search_threads = 1;  // solve this many step lengths of a line search at once, the chosen one does not change
+    bool newton_step = false;  // search along projected Newton directions from get_hessian, with the curvature made positive
+    bool collect_stats = false;  // time the phases into TimeAllocator::stats, the counters are kept anyway
+    bool verbose = false;
+    int print_level = 0;  // for the gradient routines, only on the thread running this allocator
+};
+
+
+/* Refine the time allocation of a corridor by projected gradient descent with backtracking line search.
+ * This is the C++ version of IndoorOptProblem.refine_time_by_backtrack using QPSolver and the analytic gradient,
+ * so a whole refinement is one call from Python.
+ */
+class TimeAllocator{
+public:
+    TimeAllocatorSettings settings;
+    QPSolver qp;
+    AxisSplitQP split_qp;  // used instead of qp if settings.split_axes
+    BandedIPMSolver ipm;  // used instead of qp if settings.banded_ipm
+
+    // state after the last solve, same names as in IndoorOptProblem
+    VX room_time;
+    VX sol, lmdy, lmdz;
+    double obj = 0;
+    bool is_solved = false;
+    int major_iteration = 0;
+    int num_prob_solve = 0;
+    double time_cost = 0;
+    std::string converge_reason;
+    std::vector<double> log;  // obj, duration pairs
+    PlannerStats stats;
+
+    // ws holds the assembly buffers, e.g. one per thread when solving a batch
+    TimeAllocator(const TGProblem &tgp, const MatrixXd &MQM_, const TimeAllocatorSettings &settings_ = TimeAllocatorSettings(),
+            ProblemWorkspace *ws = nullptr);
+
+    // solve the QP with the given time allocation
+    bool solve_with_room_time(cRefVX rm_time);
+
+    // solve with the current time allocation
+    bool solve_once();
+
+    /* Start the next QPSolver solve from x and the multipliers lmdy, lmdz, e.g. a previous plan of a shifted corridor.
+     * They need not be feasible, z is A x clipped to the bounds. Ignored with split_axes or banded_ipm.
+     */
+    void set_warm_start(cRefVX x, cRefVX ly, cRefVX lz);
+
+    /* Take over a solution found elsewhere, e.g. by IndoorQPProblemOTT, as the last solution at rm_time. obj includes
+     * the total time term. QPSolver is warm started from it, compute_sensitivity needs a solve here. Returns false if
+     * the sizes do not match this problem.
+     */
+    bool set_solution(cRefVX rm_time, cRefVX x, cRefVX ly, cRefVX lz, double obj_);
+
+    // gradient of the objective w.r.t. room_time at the last solution
+    VX get_gradient();
+
+    /* Second derivative of the optimal cost with respect to room_time times v, approximated by central differences of
+     * the gradient formula along v and the derivatives of the solution and multipliers from the KKT system on the
+     * active set of the last solution. Only available with QPSolver, as compute_sensitivity.
+     */
+    bool hessian_vector_product_fd(cRefVX v, VX &hv);
+
+    // the whole Hessian, one hessian_vector_product_fd per room, symmetrized
+    bool get_hessian(MatrixXd &H);
+
+    /* Gradient by finite differences of obj with step h, forward from the last solution or central. The perturbed
+     * problems are solved concurrently on copies of this allocator, num_threads 0 uses every core, and the state of
+     * this one is left as it is. Needs a solution, every entry is NaN without one, and a perturbed problem that fails
+     * gives an infinite entry.
+     */
+    VX get_gradient_fd(double h = 1e-6, bool central = false, int num_threads = 0);
+
+    // the same along the directions of Mellinger, h on one room and -h / (n - 1) on the others, so the total time is kept
+    VX get_gradient_mellinger(double h = 1e-6, bool central = false, int num_threads = 0);
+
+    /* Derivatives of sol, lmdy and lmdz along a change dtime of room_time, from the KKT system on the active set of the
+     * last solution. Only available with QPSolver, i.e. neither split_axes nor banded_ipm, returns false otherwise.
+     */
+    bool compute_sensitivity(cRefVX dtime);
+
+    /* Solve at room_time + alpha * dtime of the last compute_sensitivity. The first order prediction of the solution is
+     * accepted if it already is one, otherwise it warm starts QPSolver.
+     */
+    bool solve_with_prediction(double alpha);
+
+    /* Returns is_okay, converged. Every trial of a line search starts from the solver state at the current point, so
+     * with line_search_threads > 1 the next trials are solved at once on copies of this allocator and the same step is
+     * chosen as one by one. num_prob_solve then also counts the trials solved ahead but not needed.
+     */
+    std::pair<bool, bool> refine_time_by_backtrack();
+
+    /* How hard the corridor and the velocity and acceleration limits hold each segment at the last solution: the sum of
+     * |lmdz| over its variables and of |lmdy| over its inequality rows, the boundary and continuity equalities do not
+     * count. Zero for every segment if not solved. This is what sliceCorridorAdaptive ranks the boxes by.
+     */
+    VX segment_activity() const;
+
+    int num_box() const {return corridor.size();}
+
+    // matrices at the current room_time, also after a line search that rolled back
+    const ConstraintMatrix &get_constraint() const {return constraint;}
+
+private:
+    TGProblem problem;
+    std::vector<pyBox> corridor;
+    MatrixXd MQM;
+    ConstraintMatrix constraint;  // only values change between solves
+    ObjectiveMatrix objective;
+    std::vector<pyBox> grad_corridor;  // corridor with the times gradient_at is evaluated at
+    ProblemWorkspace grad_work;  // buffers of gradient_from_A
+
+    // first order model of the solution along a direction of room_time, see compute_sensitivity
+    struct SolutionSensitivity{
+        bool valid = false;
+        VX time, dtime;
+        VX sol, lmdy, lmdz;
+        VX dsol, dlmdy, dlmdz;
+    } sens;
+
+    // solver state every trial of a line search starts from, so a trial does not depend on the ones before it
+    struct TrialStart{
+        QPSolver::WarmStart qp, split[3];
+    } trial_start;
+
+    /* Copies of this allocator that solve line search trials and finite differences, with the pool running them. They
+     * are kept between calls so threads and matrices are set up once, each call only passes over the settings and the
+     * solver state to start from. A copy of this allocator starts without any.
+     */
+    struct WorkerSet;
+    struct WorkerHandle{
+        std::unique_ptr<WorkerSet> set;
+        WorkerHandle();
+        WorkerHandle(const WorkerHandle &);
+        WorkerHandle &operator=(const WorkerHandle &);
+        ~WorkerHandle();
+    } workers;
+
+    double *stat_timer(double &field) {return settings.collect_stats ? &field : nullptr;}
+    void update_matrices();  // objective and constraint at the current room_time
+    bool solve_qp();  // solve with the matrices at the current room_time
+    VX gradient_at(cRefVX rm_time, cRefVX x, cRefVX ly, cRefVX lz);
+    bool solution_derivative(cRefVX dtime, VX &dsol, VX &dlmdy, VX &dlmdz);
+    bool newton_direction(cRefVX grad, VX &p);
+    VX directional_differences(const MatrixXd &dirs, double h, bool central, int num_threads);
+    void save_trial_start();
+    void restore_trial_start();
+    WorkerSet &worker_set(int num_threads);  // a pool of num_threads and as many workers
+    void sync_worker(TimeAllocator &worker, const TrialStart &start) const;
+    void add_worker_counters(const TimeAllocator &worker);
+    int solve_trials(WorkerSet &set, int j, double alpha, cRefVX t_now, cRefVX p, bool use_prediction,
+            std::vector<int> &slot);
+    void take_trial(const TimeAllocator &trial);
+};
+
+#endif /* !TIME_ALLOCATOR_H */
@@ -0,0 +1,94 @@
+/*
+ * trace_recorder.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/* Spans of the planner in the Chrome trace event format, for chrome://tracing, Perfetto or any viewer reading it.
+ * Events go into a ring allocated at construction, once it is full the oldest ones are overwritten, so recording
+ * never allocates and a long run keeps its most recent part. Names and argument keys must be string literals.
+ * Adding is serialized by a mutex, so the workers of a parallel line search can record into the same ring.
+ */
+class TraceRecorder{
+public:
+    static const int MAX_ARGS = 4;
+
+    struct Event{
+        const char *name = nullptr;
+        double ts = 0, dur = 0;  // microseconds since the recorder was created
+        int tid = 0;  // index of the recording thread in order of appearance
+        int n_args = 0;
+        const char *keys[MAX_ARGS];
+        double values[MAX_ARGS];
+    };
+
+    explicit TraceRecorder(size_t capacity = 1 << 16);
+
+    void add(Event event, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+    void clear();
+
+    size_t capacity() const {return events.size();}
+    size_t size() const {return count;}
+    size_t dropped() const {return n_dropped;}
+
+    // the events from the oldest on, as a JSON object with a traceEvents array
+    std::string to_json() const;
+    bool write_json(const std::string &file_name) const;
+
+private:
+    mutable std::mutex lock;
+    std::chrono::steady_clock::time_point origin;
+    std::vector<Event> events;
+    size_t head = 0, count = 0, n_dropped = 0;
+    std::vector<std::thread::id> threads;
+};
+
+
+// the recorder the planner writes into, none by default; the caller keeps it alive while it is set
+void set_tracer(TraceRecorder *tracer);
+
+TraceRecorder *get_tracer();
+
+
+// one span from construction to destruction with up to MAX_ARGS numeric arguments, does nothing without a tracer
+class TraceSpan{
+public:
+    TraceSpan(const char *name) : tracer(get_tracer()){
+        if(tracer){
+            event.name = name;
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    ~TraceSpan(){
+        if(tracer)
+            tracer->add(event, start, std::chrono::steady_clock::now());
+    }
+
+    void arg(const char *key, double value){
+        if(tracer && event.n_args < TraceRecorder::MAX_ARGS){
+            event.keys[event.n_args] = key;
+            event.values[event.n_args] = value;
+            event.n_args++;
+        }
+    }
+
+    bool active() const {return tracer != nullptr;}
+
+private:
+    TraceRecorder *tracer;
+    TraceRecorder::Event event;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif /* !TRACE_RECORDER_H */
@@ -0,0 +1,53 @@
+/*
+ * trajectory_evaluator.h
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#ifndef TRAJECTORY_EVALUATOR_H
+#define TRAJECTORY_EVALUATOR_H
+
+#include <vector>
+
+#include "ott/pybind_box_type.h"
+
+
+/* Position and derivatives of the piecewise polynomial trajectory of a solution, at any number of times.
+ * The control points of each segment are turned into monomial coefficients in the time since the segment start once,
+ * as get_output_coefficients of IndoorQPProblem, with x, y, z in the lanes of one Eigen packet. A query finds its
+ * segment by binary search over the cumulative times, or by a step from the previous one if the times are sorted, and
+ * a single Horner pass over the coefficients gives every derivative up to the one asked for.
+ */
+class TrajectoryEvaluator{
+public:
+    TrajectoryEvaluator(){}
+
+    // M maps the control points of a segment to its monomial coefficients in s in [0, 1], Bernstein::getM()[order]
+    TrajectoryEvaluator(const MatrixXd &M_, cRefVX sol, cRefVX room_time);
+
+    // a new solution of the same order, same layout as IndoorQPProblem.sol
+    void set_solution(cRefVX sol, cRefVX room_time);
+
+    /* Derivatives 0 to max_deriv at each of the n times, written to out as n x (max_deriv + 1) x 3 row major, i.e.
+     * x, y, z of the position, then of the velocity and so on. The times need not be sorted, times outside
+     * [0, total_time()] are clamped. Derivatives above the order of the polynomials are 0.
+     */
+    void evaluate(const double *times, int n, int max_deriv, double *out) const;
+
+    // index of the segment holding time t, a time on a joint belongs to the segment before it, as in get_output_path
+    int locate(double t) const;
+
+    int num_segment() const {return end_time.size();}
+    int order() const {return poly_order;}
+    double total_time() const {return end_time.size() > 0 ? end_time(end_time.size() - 1) : 0;}
+
+private:
+    MatrixXd M;
+    int poly_order = 0;
+    VX end_time;  // cumulative time at the end of each segment
+    // one column per segment and power, the coefficient of (t - start)^k of x, y, z and a padding lane
+    MatrixXd coef;
+};
+
+#endif /* !TRAJECTORY_EVALUATOR_H */
@@ -25,10 +25,15 @@ from scipy.interpolate import BPoly
 from mpl_toolkits.mplot3d.art3d import Poly3DCollection
 
 # third party libraries
-import mosek
+try:
+    import mosek
+except ImportError:
+    mosek = None  # we can still use the built-in QP solver in libott
 from tabulate import tabulate
 
-from libott import loadTGP, construct_P, construct_A, gradient_from_P, gradient_from_A, set_print_level
+from libott import loadTGP, construct_P, construct_A, assemble_A, gradient_from_P, gradient_from_A, set_print_level
+from libott import ProblemWorkspace, solve_batch, BatchOptions
+from libott import QPSolver, QP_SOLVED, TimeAllocator, TimeAllocatorSettings, BandedIPMSolver, TrajectoryEvaluator
 from libbezier import Bezier
 
 
@@ -200,26 +205,21 @@ class IndoorOptProblem(object):
         :return: ndarray, (n, 2) the optimal path
         """
         cum_sum_time = np.cumsum(self.room_time)
-        output = np.zeros((n, 3))  # the output trajectory
         sample_time = np.linspace(0, cum_sum_time[-1], n)
-        n_room = self.num_box
-
-        # get all the coef of polynomials
-        t, all_poly_coeffs = self.get_output_coefficients()
-        for i in range(n_room):
-            # poly_coef = self.bzM.dot(mat_x[i]) * self.room_time[i]
-            poly_coef = all_poly_coeffs[i,:,:]
-            if i == 0:
-                t_mask = sample_time <= cum_sum_time[0]
-                use_s = sample_time[t_mask] / cum_sum_time[0]
-            else:
-                t_mask = (sample_time > cum_sum_time[i - 1]) & (sample_time <= cum_sum_time[i])
-                use_s = (sample_time[t_mask] - cum_sum_time[i - 1]) / self.room_time[i]
-            output[t_mask, 0] = np.polyval(poly_coef[:, 0][::-1], use_s)
-            output[t_mask, 1] = np.polyval(poly_coef[:, 1][::-1], use_s)
-            output[t_mask, 2] = np.polyval(poly_coef[:, 2][::-1], use_s)
+        output = self.get_output_derivatives(sample_time, 0)[:, 0, :]
         return cum_sum_time[-1], output
 
+    def get_output_derivatives(self, sample_time, max_deriv=3, out=None):
+        """Evaluate the trajectory and its derivatives at many times.
+
+        :param sample_time: ndarray, (n,) times from the start, sorted or not, clamped to the total time
+        :param max_deriv: int, the highest derivative, 3 gives position, velocity, acceleration and jerk
+        :param out: ndarray, (n, max_deriv + 1, 3) float64, written in place if given
+        :return: ndarray, (n, max_deriv + 1, 3)
+        """
+        evaluator = TrajectoryEvaluator(self.bzM, self.sol, self.room_time)
+        return evaluator.evaluate(sample_time, max_deriv, out)
+
     def get_gradient(self):
         raise NotImplementedError
 
@@ -637,6 +637,9 @@ class IndoorQPProblem(IndoorOptProblem):
     def __init__(self, tgp, tfweight=0, connect_order=2, verbose=False):
         IndoorOptProblem.__init__(self, tgp, tfweight, connect_order, verbose)
         self.h_type = 'F'
+        # buffers of construct_A and get_gradient, self.lincon, the bounds and sp_A are views of the constraints and
+        # change with the next construct_A
+        self.workspace = ProblemWorkspace()
 
     def update_prob(self):
         """Just update the problem since we are changing pretty fast.
@@ -660,7 +663,8 @@ class IndoorQPProblem(IndoorOptProblem):
         self.qp_q = np.zeros(self.n_var)
 
     def construct_A(self):
-        lincon = construct_A(
+        lincon = assemble_A(
+                self.workspace,
                 self.floor.getCorridor(),
                 self.MQM,
                 self.floor.position.copy(order='F'),
@@ -673,17 +677,19 @@ class IndoorQPProblem(IndoorOptProblem):
                 self.floor.margin,
                 self.floor.doLimitVelocity,
                 self.floor.doLimitAcceleration)
+        self.lincon = lincon
         self.xlb = lincon.xlb
         self.xub = lincon.xub
         self.clb = lincon.clb
         self.cub = lincon.cub
         # we need more
-        self.sp_A = coo_matrix((lincon.aval, (lincon.arow, lincon.acol)))
+        # the compressed column arrays come straight from libott, no sorting needed here
+        self.sp_A = csc_matrix((lincon.values, lincon.rowind, lincon.colptr), shape=(lincon.n_con, lincon.n_var))
         self.n_con = self.sp_A.shape[0]
         if self.verbose > 1:
             print('n_con', self.n_con)
             print('n_var', self.sp_A.shape[1])
-            print("A has %d nnz" % lincon.aval.shape[0])
+            print("A has %d nnz" % lincon.n_nnz)
 
     def eval_cost_constr(self, mat_in):
         """Pass in a coefficient matrix, see results."""
@@ -704,6 +710,7 @@ class IndoorQPProblem(IndoorOptProblem):
     def get_gradient(self, sol, lmdy, lmdz):
         pgrad = gradient_from_P(self.obj_order, self.num_box, self.poly_order, self.room_time, self.MQM, sol)
         agrad = gradient_from_A(
+                    self.workspace,
                     self.floor.getCorridor(),
                     self.MQM,
                     self.floor.position.copy(order='F'),
@@ -743,8 +750,7 @@ class IndoorQPProblemMOSEK(IndoorQPProblem):
     def solve_once(self):
         self.update_prob()
         # set up A
-        A_sp = self.sp_A.tocsc()
-        colptr, asub, acof = A_sp.indptr, A_sp.indices, A_sp.data
+        colptr, asub, acof = self.sp_A.indptr, self.sp_A.indices, self.sp_A.data
         aptrb, aptre = colptr[:-1], colptr[1:]
         # set up bounds on x
         bkx = self.n_var * [mosek.boundkey.ra]
@@ -793,15 +799,154 @@ class IndoorQPProblemMOSEK(IndoorQPProblem):
         return IndoorQPProblem.get_gradient(self, self.sol, self.lmdy, self.lmdz)
 
 
+class IndoorQPProblemOTT(IndoorQPProblem):
+    """Use the ADMM solver in libott, it needs no license and warm starts from the previous solve"""
+    def __init__(self, tgp, tfweight=0, connect_order=2, verbose=False):
+        IndoorQPProblem.__init__(self, tgp, tfweight, connect_order, verbose)
+        self.h_type = "L"
+        self.qp = QPSolver()
+        self.split_axes = False  # solve x, y, z separately in refine_time_by_backtrack
+        self.ipm = BandedIPMSolver(3 * (self.poly_order + 1))
+        self.banded_ipm = False  # use the interior point solver, its cost is linear in the number of segments
+        self.collect_stats = False  # time the phases of refine_time_by_backtrack, read them from self.stats
+        self.stats = None
+        self.fd_allocator = None  # kept between finite difference gradients, see _synced_allocator
+
+    def solve_once(self):
+        self.update_prob()
+        qp = self.ipm if self.banded_ipm else self.qp
+        status = qp.solve(self.sp_P.data, self.sp_P.row, self.sp_P.col, self.lincon)
+        if self.verbose:
+            print("Solving status", status, "iterations", qp.iter)
+        if status == QP_SOLVED:
+            self.is_solved = True
+            self.obj = qp.obj + self.tfweight * np.sum(self.room_time)
+            self.sol = qp.x
+            self.lmdy = qp.lmdy
+            self.lmdz = qp.lmdz
+            return status, self.sol, self.lmdy, self.lmdz
+        else:
+            self.is_solved = False
+            self.obj = np.inf
+            return status, None, None, None
+
+    def get_gradient(self):
+        return IndoorQPProblem.get_gradient(self, self.sol, self.lmdy, self.lmdz)
+
+    def _allocator(self, setting=None):
+        """A TimeAllocator at the current room_time using the solver settings of this problem."""
+        if setting is None:
+            setting = TimeAllocatorSettings()
+            setting.tfweight = self.tfweight
+            setting.split_axes = self.split_axes
+            setting.banded_ipm = self.banded_ipm
+            setting.collect_stats = self.collect_stats
+        self.floor.updateCorridorTime(self.room_time)
+        allocator = TimeAllocator(self.floor, self.MQM, setting)
+        allocator.qp.settings = self.qp.settings
+        allocator.ipm.settings = self.ipm.settings
+        return allocator
+
+    def _synced_allocator(self):
+        """The TimeAllocator of the finite differences at the last solution of this problem.
+
+        It is kept between calls, only the settings and the solution are passed over, so the differences are taken
+        from self.obj and every perturbed problem is warm started from self.sol. Solves first if not solved yet.
+        """
+        if not getattr(self, 'is_solved', False):
+            self.solve_once()
+        if not self.is_solved:
+            return self._allocator()  # not solved either, so it gives NaN
+        if self.fd_allocator is None or self.fd_allocator.num_box() != self.num_box:
+            self.fd_allocator = self._allocator()
+        allocator = self.fd_allocator
+        setting = allocator.settings
+        setting.tfweight = self.tfweight
+        setting.split_axes = self.split_axes
+        setting.banded_ipm = self.banded_ipm
+        setting.collect_stats = self.collect_stats
+        allocator.settings = setting
+        allocator.qp.settings = self.qp.settings
+        allocator.ipm.settings = self.ipm.settings
+        allocator.set_solution(self.room_time, self.sol, self.lmdy, self.lmdz, self.obj)
+        return allocator
+
+    def get_gradient_fd(self, h=1e-6, central=False, num_threads=0):
+        """Finite difference gradient, the perturbed problems are solved concurrently in libott.
+
+        Unlike IndoorOptProblem.get_gradient_fd, room_time and obj are left unchanged. obj already includes the
+        total time term so tfweight is not added again. NaN everywhere if the problem cannot be solved.
+        """
+        return np.array(self._synced_allocator().get_gradient_fd(h, central, num_threads))
+
+    def get_gradient_mellinger(self, h=1e-6, central=False, num_threads=0):
+        """Gradient along the directions of Mellinger, the perturbed problems are solved concurrently in libott."""
+        return np.array(self._synced_allocator().get_gradient_mellinger(h, central, num_threads)) + self.tfweight
+
+    def refine_time_by_backtrack(self, alpha0=0.175, h=1e-5, c=0.2, tau=0.2, max_iter=50, j_iter=5, log=False, timeProfile=False, adaptiveLineSearch=False):
+        """Same as IndoorOptProblem.refine_time_by_backtrack but the whole loop runs in libott.
+
+        Only the analytic gradient is available there, other grad_method fall back to the Python loop.
+        """
+        if getattr(self, 'grad_method', 'ours') != 'ours' or timeProfile:
+            return IndoorQPProblem.refine_time_by_backtrack(self, alpha0, h, c, tau, max_iter, j_iter, log, timeProfile, adaptiveLineSearch)
+        setting = TimeAllocatorSettings()
+        setting.alpha0 = alpha0
+        setting.c = c
+        setting.tau = tau
+        setting.max_iter = max_iter
+        setting.j_iter = j_iter
+        setting.log = log
+        setting.adaptive_line_search = adaptiveLineSearch
+        setting.abs_obj_tol = self.abs_obj_tol
+        setting.rel_obj_tol = self.rel_obj_tol
+        setting.grad_tol = self.grad_tol
+        setting.tfweight = self.tfweight
+        setting.verbose = bool(self.verbose)
+        setting.split_axes = self.split_axes
+        setting.banded_ipm = self.banded_ipm
+        setting.collect_stats = self.collect_stats
+        allocator = self._allocator(setting)
+        is_okay, converged = allocator.refine_time_by_backtrack()
+        # copy the state back so the output functions work as before
+        self.room_time = np.array(allocator.room_time)
+        self.floor.updateCorridorTime(self.room_time)
+        self.is_solved = allocator.is_solved
+        self.obj = allocator.obj
+        self.sol = np.array(allocator.sol)
+        self.lmdy = np.array(allocator.lmdy)
+        self.lmdz = np.array(allocator.lmdz)
+        self.major_iteration = allocator.major_iteration
+        self.num_prob_solve = allocator.num_prob_solve
+        self.time_cost = allocator.time_cost
+        self.converge_reason = allocator.converge_reason
+        self.stats = allocator.stats
+        if log:
+            self.log = np.array(allocator.log)
+        return is_okay, converged
+
+
+def loadProblem(prob):
+    """Load the prob-th problem of the dataset, the binary copy written by bin/tgp_convert is used if it exists."""
+    name = 'dataset/tgp_%d' % prob
+    if os.path.exists(name + '.tgpb'):
+        return loadTGP(name + '.tgpb')
+    return loadTGP(name + '.tgp')
+
+
 def solveProblem():
     """Test the backtrack line search with IP solver."""
     prob = 11
     if len(sys.argv) > 1:
         prob = int(sys.argv[1])
+    # which QP solver to use, mosek or ott (the built-in one)
+    solver_name = 'mosek' if mosek is not None else 'ott'
+    if len(sys.argv) > 2:
+        solver_name = sys.argv[2]
 
-    print_purple("Testing on problem: %d" % prob)
+    print_purple("Testing on problem: %d with %s" % (prob, solver_name))
 
-    tgp = loadTGP('dataset/tgp_%d.tgp' % prob)  # every time you have to reload from hard disk since it is modified before
+    tgp = loadProblem(prob)  # every time you have to reload from hard disk since it is modified before
     initial_time_allocation = np.array([box.t for box in tgp.getCorridor()])
     
     # we do not limit velocity in the open source implementation
@@ -813,7 +958,10 @@ def solveProblem():
     
     #print_green("Use Mosek + Adaptive line search")
     
-    solver = IndoorQPProblemMOSEK(tgp, verbose=False)
+    if solver_name == 'mosek':
+        solver = IndoorQPProblemMOSEK(tgp, verbose=False)
+    else:
+        solver = IndoorQPProblemOTT(tgp, verbose=False)
     
     ts1 = time.time()
     solver.solve_once()
@@ -846,7 +994,7 @@ def solveProblem():
 
     t_after_opt, coeff_after_opt = solver.get_output_coefficients()
 
-    result = [["Solver", "Mosek"], 
+    result = [["Solver", solver_name], 
                 ["Solved?", is_okay],
                 #["Converged?", converged],
                 ["Initial Cost", round(initial_obj, 3)],
@@ -970,9 +1118,41 @@ def set_axes_equal(ax):
 
 
 
+def solveAllProblems():
+    """Refine every problem in the dataset at once with the batch planner in libott."""
+    tgps = []
+    prob = 0
+    while os.path.exists('dataset/tgp_%d.tgp' % prob):
+        tgp = loadProblem(prob)
+        # same setting as solveProblem
+        tgp.doLimitVelocity = False
+        tgp.minimizeOrder = 3
+        tgp.trajectoryOrder = 6
+        tgps.append(tgp)
+        prob += 1
+    MQM = Bezier(6, 6, 3).MQM()[6]
+    options = BatchOptions()
+    options.settings.max_iter = 100
+    options.settings.adaptive_line_search = True
+    if len(sys.argv) > 2:
+        options.num_threads = int(sys.argv[2])
+
+    t0 = time.time()
+    results = solve_batch(tgps, MQM, options)
+    wall_time = time.time() - t0
+
+    table = [[i, res.is_solved, round(res.initial_obj, 3), round(res.obj, 3), res.major_iteration, round(res.solve_time * 1000, 2), res.worker]
+             for i, res in enumerate(results)]
+    print(tabulate(table, headers=["Problem", "Solved?", "Initial Cost", "Final Cost", "# Major Iterations", "Solve Time [ms]", "Thread"],
+                   tablefmt="psql", stralign="right", numalign="center"))
+    print_purple("Solved %d of %d problems in %.2f s" % (sum(res.is_solved for res in results), len(results), wall_time))
+
+
 def main():
-    
-    solveProblem()
+    if len(sys.argv) > 1 and sys.argv[1] == 'batch':
+        solveAllProblems()
+    else:
+        solveProblem()
 
 if __name__ == '__main__':
     main()
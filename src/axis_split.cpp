@@ -0,0 +1,167 @@
+/*
+ * axis_split.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <thread>
+#include <algorithm>
+
+#include "ott/axis_split.h"
+
+
+// Build the sub-matrix of the columns in cols, rows are renumbered by row_map (-1 if not in this axis).
+// src records where each value comes from in mat. Returns false if a column has a row outside the axis.
+static bool extract_block(const SpMX &mat, const std::vector<int> &cols, const std::vector<int> &row_map, int n_row,
+                          SpMX &sub, std::vector<int> &src){
+    Eigen::VectorXi col_nnz(cols.size());
+    for(size_t j = 0; j < cols.size(); j++)
+        col_nnz(j) = mat.outerIndexPtr()[cols[j] + 1] - mat.outerIndexPtr()[cols[j]];
+    sub.resize(n_row, cols.size());
+    sub.reserve(col_nnz);
+    src.clear();
+    src.reserve(col_nnz.sum());
+    for(size_t j = 0; j < cols.size(); j++){
+        for(int idx = mat.outerIndexPtr()[cols[j]]; idx < mat.outerIndexPtr()[cols[j] + 1]; idx++){
+            int r = row_map[mat.innerIndexPtr()[idx]];
+            if(r < 0)
+                return false;
+            sub.insert(r, j) = mat.valuePtr()[idx];
+            src.push_back(idx);
+        }
+    }
+    sub.makeCompressed();
+    return true;
+}
+
+
+AxisSplitQP::AxisSplitQP(const SpMX &P, const SpMX &A, int n_poly){
+    int n_var = P.cols();
+    int n_con = A.rows();
+    std::vector<int> var_axis(n_var), var_map(n_var);
+    for(int j = 0; j < n_var; j++){
+        var_axis[j] = (j / n_poly) % 3;
+        var_map[j] = axis[var_axis[j]].var.size();
+        axis[var_axis[j]].var.push_back(j);
+    }
+
+    // a row belongs to the axis of its columns
+    std::vector<int> row_axis(n_con, -1);
+    valid = true;
+    for(int j = 0; j < n_var; j++){
+        for(SpMX::InnerIterator it(A, j); it; ++it){
+            if(row_axis[it.row()] >= 0 && row_axis[it.row()] != var_axis[j])
+                valid = false;
+            row_axis[it.row()] = var_axis[j];
+        }
+    }
+    for(int i = 0; i < n_con; i++)
+        if(row_axis[i] < 0)
+            valid = false;
+    if(!valid)
+        return;
+
+    for(int i = 0; i < n_con; i++)
+        axis[row_axis[i]].row.push_back(i);
+    for(int p = 0; p < 3; p++){
+        Axis &ax = axis[p];
+        std::vector<int> var_row_map(n_var, -1), con_row_map(n_con, -1);
+        for(int j : ax.var)
+            var_row_map[j] = var_map[j];
+        for(size_t i = 0; i < ax.row.size(); i++)
+            con_row_map[ax.row[i]] = i;
+        valid = valid && extract_block(P, ax.var, var_row_map, ax.var.size(), ax.P, ax.p_src);
+        valid = valid && extract_block(A, ax.var, con_row_map, ax.row.size(), ax.A, ax.a_src);
+    }
+}
+
+
+void AxisSplitQP::reset(){
+    for(int p = 0; p < 3; p++)
+        qp[p].reset();
+    status = QP_UNSOLVED;
+}
+
+
+void AxisSplitQP::take_solution(const AxisSplitQP &other){
+    for(int p = 0; p < 3; p++){
+        qp[p].take_solution(other.qp[p]);
+        axis[p] = other.axis[p];
+    }
+    valid = other.valid;
+    x = other.x;
+    lmdy = other.lmdy;
+    lmdz = other.lmdz;
+    obj = other.obj;
+    status = other.status;
+    iter = other.iter;
+}
+
+
+void AxisSplitQP::solve_axis(int p){
+    Axis &ax = axis[p];
+    qp[p].solve(ax.P, VX::Zero(ax.var.size()), ax.A, ax.clb, ax.cub, ax.xlb, ax.xub);
+}
+
+
+int AxisSplitQP::solve(const SpMX &P, const SpMX &A, cRefVX clb, cRefVX cub, cRefVX xlb, cRefVX xub){
+    // gather the current values into the sub-problems
+    for(int p = 0; p < 3; p++){
+        Axis &ax = axis[p];
+        double *pval = ax.P.valuePtr(), *aval = ax.A.valuePtr();
+        for(size_t i = 0; i < ax.p_src.size(); i++)
+            pval[i] = P.valuePtr()[ax.p_src[i]];
+        for(size_t i = 0; i < ax.a_src.size(); i++)
+            aval[i] = A.valuePtr()[ax.a_src[i]];
+        int nv = ax.var.size(), nc = ax.row.size();
+        ax.xlb.resize(nv);
+        ax.xub.resize(nv);
+        ax.clb.resize(nc);
+        ax.cub.resize(nc);
+        for(int j = 0; j < nv; j++){
+            ax.xlb(j) = xlb(ax.var[j]);
+            ax.xub(j) = xub(ax.var[j]);
+        }
+        for(int i = 0; i < nc; i++){
+            ax.clb(i) = clb(ax.row[i]);
+            ax.cub(i) = cub(ax.row[i]);
+        }
+    }
+
+    if(parallel && std::thread::hardware_concurrency() > 1){
+        pool.run(3, [this](int p, int){solve_axis(p);});
+    }
+    else{
+        for(int p = 0; p < 3; p++)
+            solve_axis(p);
+    }
+
+    // merge back into the interleaved layout
+    status = QP_SOLVED;
+    iter = 0;
+    obj = 0;
+    for(int p = 0; p < 3; p++){
+        if(!qp[p].is_solved()){
+            status = qp[p].status;
+            break;
+        }
+    }
+    if(status != QP_SOLVED)
+        return status;
+    x.resize(xlb.size());
+    lmdz.resize(xlb.size());
+    lmdy.resize(clb.size());
+    for(int p = 0; p < 3; p++){
+        Axis &ax = axis[p];
+        for(size_t j = 0; j < ax.var.size(); j++){
+            x(ax.var[j]) = qp[p].x(j);
+            lmdz(ax.var[j]) = qp[p].lmdz(j);
+        }
+        for(size_t i = 0; i < ax.row.size(); i++)
+            lmdy(ax.row[i]) = qp[p].lmdy(i);
+        obj += qp[p].obj;
+        iter = std::max(iter, qp[p].iter);
+    }
+    return status;
+}
@@ -0,0 +1,415 @@
+/*
+ * banded_ipm.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "ott/banded_ipm.h"
+
+
+const double IPM_INF = 1e19;  // bounds beyond this are treated as absent, construct_A_matrix uses 1e20
+
+
+// largest step in (0, 1] keeping v + alpha dv >= 0 on the masked entries
+static double max_step(cRefVX v, cRefVX dv, const std::vector<char> &mask){
+    double alpha = 1;
+    for(int i = 0; i < v.size(); i++)
+        if(mask[i] && dv(i) < 0)
+            alpha = std::min(alpha, -v(i) / dv(i));
+    return alpha;
+}
+
+
+bool BandedIPMSolver::analyze(const SpMX &P, const SpMX &A, cRefVX clb, cRefVX cub, cRefVX xlb, cRefVX xub){
+    n = P.cols();
+    m = A.rows();
+    if(seg_size <= 0 || n == 0 || n % seg_size != 0 || A.cols() != n)
+        return false;
+    n_seg = n / seg_size;
+
+    segs.assign(n_seg, Segment());
+    for(int s = 0; s < n_seg; s++)
+        segs[s].P = MX::Zero(seg_size, seg_size);
+    for(int j = 0; j < n; j++){
+        int s = j / seg_size, off = s * seg_size;
+        for(SpMX::InnerIterator it(P, j); it; ++it){
+            int r = it.row();
+            if(r < j)
+                continue;
+            if(r / seg_size != s)
+                return false;
+            segs[s].P(r - off, j - off) = it.value();
+            segs[s].P(j - off, r - off) = it.value();
+        }
+    }
+
+    // the segments touched by each row
+    std::vector<int> rmin(m, n_seg), rmax(m, -1);
+    for(int j = 0; j < n; j++){
+        int s = j / seg_size;
+        for(SpMX::InnerIterator it(A, j); it; ++it){
+            rmin[it.row()] = std::min(rmin[it.row()], s);
+            rmax[it.row()] = std::max(rmax[it.row()], s);
+        }
+    }
+    blocks.assign(n_seg, Block());
+    is_eq.assign(m, 0);
+    std::vector<int> local(m, -1);  // index of a row inside its segment or block
+    for(int i = 0; i < m; i++){
+        if(rmax[i] < 0)
+            continue;  // empty row
+        is_eq[i] = clb(i) == cub(i);
+        if(is_eq[i]){
+            if(rmax[i] - rmin[i] > 1)
+                return false;
+            local[i] = blocks[rmin[i]].row.size();
+            blocks[rmin[i]].row.push_back(i);
+        }
+        else{
+            if(rmax[i] != rmin[i])
+                return false;
+            local[i] = segs[rmin[i]].irow.size();
+            segs[rmin[i]].irow.push_back(i);
+        }
+    }
+    for(int s = 0; s < n_seg; s++)
+        segs[s].AI = MX::Zero(segs[s].irow.size(), seg_size);
+    for(int b = 0; b < n_seg; b++){
+        blocks[b].F = MX::Zero(blocks[b].row.size(), seg_size);
+        blocks[b].G = MX::Zero(blocks[b].row.size(), b + 1 < n_seg ? seg_size : 0);
+    }
+    for(int j = 0; j < n; j++){
+        int s = j / seg_size, jj = j - s * seg_size;
+        for(SpMX::InnerIterator it(A, j); it; ++it){
+            int i = it.row();
+            if(!is_eq[i])
+                segs[s].AI(local[i], jj) = it.value();
+            else if(rmin[i] == s)
+                blocks[s].F(local[i], jj) = it.value();
+            else
+                blocks[rmin[i]].G(local[i], jj) = it.value();
+        }
+    }
+
+    // inequality bounds over the rows of [A; I]
+    lo.resize(m + n);
+    up.resize(m + n);
+    has_l.assign(m + n, 0);
+    has_u.assign(m + n, 0);
+    for(int i = 0; i < m + n; i++){
+        bool is_row = i < m;
+        lo(i) = is_row ? clb(i) : xlb(i - m);
+        up(i) = is_row ? cub(i) : xub(i - m);
+        if(is_row && (is_eq[i] || rmax[i] < 0))
+            continue;
+        has_l[i] = lo(i) > -IPM_INF;
+        has_u[i] = up(i) < IPM_INF;
+    }
+    return true;
+}
+
+
+VX BandedIPMSolver::mult_P(cRefVX v) const{
+    VX out(n);
+    for(int s = 0; s < n_seg; s++)
+        out.segment(s * seg_size, seg_size).noalias() = segs[s].P * v.segment(s * seg_size, seg_size);
+    return out;
+}
+
+
+// Cholesky of a block that is positive definite in exact arithmetic. The regularization starts at settings.reg and,
+// if rounding makes a pivot negative (the barrier terms span many orders of magnitude near the solution), grows
+// relative to the largest diagonal entry. The KKT solve is refined against the unregularized blocks afterwards.
+bool BandedIPMSolver::regularized_llt(const MX &M, Eigen::LLT<MX> &llt) const{
+    if(M.rows() == 0)
+        return true;
+    double scale = std::max(1.0, M.diagonal().maxCoeff());
+    MX Mr = M;
+    double delta = settings.reg;
+    while(true){
+        Mr.diagonal() = M.diagonal().array() + delta;
+        llt.compute(Mr);
+        if(llt.info() == Eigen::Success)
+            return true;
+        if(delta >= 1e-4 * scale)
+            return false;
+        delta = std::max(100 * delta, settings.reg * scale);
+    }
+}
+
+
+// factor the condensed Hessian of every segment and the block tridiagonal Schur complement A_E W^-1 A_E'
+bool BandedIPMSolver::factorize(cRefVX sigma){
+    for(int s = 0; s < n_seg; s++){
+        Segment &sg = segs[s];
+        VX sig_row(sg.irow.size());
+        for(size_t i = 0; i < sg.irow.size(); i++)
+            sig_row(i) = sigma(sg.irow[i]);
+        sg.W = sg.P;
+        sg.W.noalias() += sg.AI.transpose() * sig_row.asDiagonal() * sg.AI;
+        sg.W.diagonal() += sigma.segment(m + s * seg_size, seg_size);
+        if(!regularized_llt(sg.W, sg.llt))
+            return false;
+    }
+    for(int b = 0; b < n_seg; b++){
+        Block &bk = blocks[b];
+        bk.V = segs[b].llt.solve(bk.F.transpose());
+        MX S = bk.F * bk.V;
+        if(b + 1 < n_seg){
+            bk.U = segs[b + 1].llt.solve(bk.G.transpose());
+            S.noalias() += bk.G * bk.U;
+        }
+        if(b > 0){
+            Block &prev = blocks[b - 1];
+            // L_{b,b-1} = S_{b,b-1} L_{b-1}^-T with S_{b,b-1} = F_b W_b^-1 G_{b-1}'
+            MX Sbp = bk.F * prev.U;
+            prev.L = prev.llt.matrixL().solve(Sbp.transpose()).transpose();
+            S.noalias() -= prev.L * prev.L.transpose();
+        }
+        if(!regularized_llt(S, bk.llt))
+            return false;
+    }
+    return true;
+}
+
+
+// solve [W A_E'; A_E 0] [dx; dy] = [r1; r2], r2 and dy live on the equality rows of vectors of size m
+void BandedIPMSolver::solve_kkt(cRefVX r1, cRefVX r2, RefVX dx, RefVX dy) const{
+    std::vector<VX> w(n_seg), z(n_seg);
+    for(int s = 0; s < n_seg; s++)
+        w[s] = segs[s].llt.solve(r1.segment(s * seg_size, seg_size));
+    // forward substitution with the block Cholesky factor
+    for(int b = 0; b < n_seg; b++){
+        const Block &bk = blocks[b];
+        VX rhs = bk.F * w[b];
+        if(b + 1 < n_seg)
+            rhs.noalias() += bk.G * w[b + 1];
+        for(size_t i = 0; i < bk.row.size(); i++)
+            rhs(i) -= r2(bk.row[i]);
+        if(b > 0)
+            rhs.noalias() -= blocks[b - 1].L * z[b - 1];
+        z[b] = bk.llt.matrixL().solve(rhs);
+    }
+    // backward substitution, z becomes the multipliers
+    for(int b = n_seg - 1; b >= 0; b--){
+        const Block &bk = blocks[b];
+        if(b + 1 < n_seg)
+            z[b].noalias() -= bk.L.transpose() * z[b + 1];
+        z[b] = bk.llt.matrixU().solve(z[b]);
+        for(size_t i = 0; i < bk.row.size(); i++)
+            dy(bk.row[i]) = z[b](i);
+    }
+    for(int s = 0; s < n_seg; s++){
+        VX d = w[s] - blocks[s].V * z[s];
+        if(s > 0)
+            d.noalias() -= blocks[s - 1].U * z[s - 1];
+        dx.segment(s * seg_size, seg_size) = d;
+    }
+}
+
+
+// solve_kkt followed by refinement steps against the unregularized system
+void BandedIPMSolver::solve_kkt_refined(const SpMX &A, cRefVX r1, cRefVX r2, RefVX dx, RefVX dy) const{
+    solve_kkt(r1, r2, dx, dy);
+    VX res1(n), res2 = VX::Zero(m), ddx(n), ddy = VX::Zero(m);
+    for(int k = 0; k < settings.refine_iter; k++){
+        VX Adx = A * dx;
+        res1 = r1 - A.transpose() * dy;
+        for(int s = 0; s < n_seg; s++)
+            res1.segment(s * seg_size, seg_size).noalias() -= segs[s].W * dx.segment(s * seg_size, seg_size);
+        for(int i = 0; i < m; i++)
+            if(is_eq[i])
+                res2(i) = r2(i) - Adx(i);
+        solve_kkt(res1, res2, ddx, ddy);
+        dx += ddx;
+        dy += ddy;
+    }
+}
+
+
+int BandedIPMSolver::solve(const SpMX &P, cRefVX q, const SpMX &A, cRefVX clb, cRefVX cub, cRefVX xlb, cRefVX xub){
+    iter = 0;
+    if(!analyze(P, A, clb, cub, xlb, xub)){
+        status = QP_INVALID_DATA;
+        return status;
+    }
+    int nc = m + n;
+    int n_ineq = 0;
+    for(int i = 0; i < nc; i++)
+        n_ineq += has_l[i] + has_u[i];
+
+    // start in the middle of the variable bounds with unit slacks and multipliers
+    x.resize(n);
+    for(int j = 0; j < n; j++){
+        int i = m + j;
+        if(has_l[i] && has_u[i])
+            x(j) = 0.5 * (lo(i) + up(i));
+        else if(has_l[i])
+            x(j) = lo(i) + 1;
+        else if(has_u[i])
+            x(j) = up(i) - 1;
+        else
+            x(j) = 0;
+    }
+    VX Cx(nc);
+    Cx.head(m) = A * x;
+    Cx.tail(n) = x;
+    sl = VX::Ones(nc);
+    su = VX::Ones(nc);
+    zl = VX::Zero(nc);
+    zu = VX::Zero(nc);
+    for(int i = 0; i < nc; i++){
+        if(has_l[i]){
+            sl(i) = std::max(Cx(i) - lo(i), 1.0);
+            zl(i) = 1;
+        }
+        if(has_u[i]){
+            su(i) = std::max(up(i) - Cx(i), 1.0);
+            zu(i) = 1;
+        }
+    }
+    y = VX::Zero(m);
+
+    VX lam(m), rd(n), re = VX::Zero(m), rl(nc), ru(nc), sigma(nc), g(nc), r1(n), r2(m);
+    VX dx(n), dy = VX::Zero(m), dCx(nc), dsl(nc), dsu(nc), dzl(nc), dzu(nc), rcl(nc), rcu(nc);
+    VX Px(n);
+
+    // Newton direction for the complementarity residuals rcl, rcu at the current factorization
+    auto direction = [&](){
+        for(int i = 0; i < nc; i++){
+            g(i) = 0;
+            if(has_l[i])
+                g(i) += (-rcl(i) - zl(i) * rl(i)) / sl(i);
+            if(has_u[i])
+                g(i) -= (-rcu(i) - zu(i) * ru(i)) / su(i);
+        }
+        r1 = -rd + A.transpose() * g.head(m) + g.tail(n);
+        r2 = -re;
+        solve_kkt_refined(A, r1, r2, dx, dy);
+        dCx.head(m) = A * dx;
+        dCx.tail(n) = dx;
+        for(int i = 0; i < nc; i++){
+            dsl(i) = has_l[i] ? dCx(i) + rl(i) : 0;
+            dsu(i) = has_u[i] ? -dCx(i) + ru(i) : 0;
+            dzl(i) = has_l[i] ? (-rcl(i) - zl(i) * dsl(i)) / sl(i) : 0;
+            dzu(i) = has_u[i] ? (-rcu(i) - zu(i) * dsu(i)) / su(i) : 0;
+        }
+    };
+
+    status = QP_MAX_ITER_REACHED;
+    for(iter = 1; iter <= settings.max_iter; iter++){
+        Cx.head(m) = A * x;
+        Cx.tail(n) = x;
+        for(int i = 0; i < m; i++)
+            lam(i) = is_eq[i] ? y(i) : zu(i) - zl(i);
+        Px = mult_P(x);
+        VX Atlam = A.transpose() * lam;
+        rd = Px + q + Atlam + zu.tail(n) - zl.tail(n);
+        for(int i = 0; i < nc; i++){
+            rl(i) = has_l[i] ? Cx(i) - lo(i) - sl(i) : 0;
+            ru(i) = has_u[i] ? up(i) - Cx(i) - su(i) : 0;
+        }
+        double max_bound = 0;
+        for(int i = 0; i < m; i++){
+            if(is_eq[i]){
+                re(i) = Cx(i) - clb(i);
+                max_bound = std::max(max_bound, std::abs(clb(i)));
+            }
+        }
+        double comp = 0;
+        for(int i = 0; i < nc; i++){
+            if(has_l[i]){
+                comp += sl(i) * zl(i);
+                max_bound = std::max(max_bound, std::abs(lo(i)));
+            }
+            if(has_u[i]){
+                comp += su(i) * zu(i);
+                max_bound = std::max(max_bound, std::abs(up(i)));
+            }
+        }
+        double mu = n_ineq > 0 ? comp / n_ineq : 0;
+        obj = 0.5 * x.dot(Px) + q.dot(x);
+
+        prim_res = std::max(re.lpNorm<Eigen::Infinity>(), std::max(rl.lpNorm<Eigen::Infinity>(), ru.lpNorm<Eigen::Infinity>()));
+        dual_res = rd.lpNorm<Eigen::Infinity>();
+        gap = mu;
+        double eps_prim = settings.eps_abs + settings.eps_rel * std::max(Cx.lpNorm<Eigen::Infinity>(), max_bound);
+        double eps_dual = settings.eps_abs + settings.eps_rel * std::max(std::max(Px.lpNorm<Eigen::Infinity>(), q.lpNorm<Eigen::Infinity>()),
+                                                                        Atlam.lpNorm<Eigen::Infinity>());
+        double eps_gap = settings.eps_abs + settings.eps_rel * std::abs(obj);
+        if(prim_res <= eps_prim && dual_res <= eps_dual && mu <= eps_gap){
+            status = QP_SOLVED;
+            break;
+        }
+        if(!std::isfinite(prim_res) || !std::isfinite(dual_res)){
+            status = QP_NON_CVX;
+            break;
+        }
+
+        for(int i = 0; i < nc; i++)
+            sigma(i) = (has_l[i] ? zl(i) / sl(i) : 0) + (has_u[i] ? zu(i) / su(i) : 0);
+        if(!factorize(sigma)){
+            status = QP_NON_CVX;
+            break;
+        }
+
+        // predictor
+        rcl = sl.cwiseProduct(zl);
+        rcu = su.cwiseProduct(zu);
+        direction();
+        double alpha_p = std::min(max_step(sl, dsl, has_l), max_step(su, dsu, has_u));
+        double alpha_d = std::min(max_step(zl, dzl, has_l), max_step(zu, dzu, has_u));
+        double comp_aff = 0;
+        for(int i = 0; i < nc; i++){
+            if(has_l[i])
+                comp_aff += (sl(i) + alpha_p * dsl(i)) * (zl(i) + alpha_d * dzl(i));
+            if(has_u[i])
+                comp_aff += (su(i) + alpha_p * dsu(i)) * (zu(i) + alpha_d * dzu(i));
+        }
+        double sigma_mu = n_ineq > 0 ? std::pow(comp_aff / comp, 3) * mu : 0;
+
+        // corrector with centering
+        for(int i = 0; i < nc; i++){
+            rcl(i) = has_l[i] ? sl(i) * zl(i) + dsl(i) * dzl(i) - sigma_mu : 0;
+            rcu(i) = has_u[i] ? su(i) * zu(i) + dsu(i) * dzu(i) - sigma_mu : 0;
+        }
+        direction();
+        double alpha = std::min(std::min(max_step(sl, dsl, has_l), max_step(su, dsu, has_u)),
+                                std::min(max_step(zl, dzl, has_l), max_step(zu, dzu, has_u)));
+        alpha = std::min(1.0, settings.step_ratio * alpha);
+
+        x += alpha * dx;
+        y += alpha * dy;
+        sl += alpha * dsl;
+        su += alpha * dsu;
+        zl += alpha * dzl;
+        zu += alpha * dzu;
+    }
+
+    if(status == QP_SOLVED){
+        lmdy = lam;
+        lmdz = zu.tail(n) - zl.tail(n);
+    }
+    else{
+        iter = std::min(iter, settings.max_iter);
+    }
+    return status;
+}
+
+
+int BandedIPMSolver::solve_triplets(cRefVX pval, const lVX &prow, const lVX &pcol, const LinearConstr &lincon){
+    int n_var = lincon.n_var;
+    std::vector<Eigen::Triplet<double> > trip;
+    trip.reserve(pval.size());
+    for(int i = 0; i < pval.size(); i++)
+        trip.push_back(Eigen::Triplet<double>(prow(i), pcol(i), pval(i)));
+    SpMX P(n_var, n_var);
+    P.setFromTriplets(trip.begin(), trip.end());
+    Eigen::Map<const SpMX> A(lincon.n_con, n_var, lincon.n_nnz, lincon.colptr.data(), lincon.rowind.data(), lincon.values.data());
+    return solve(P, VX::Zero(n_var), A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+}
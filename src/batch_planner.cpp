@@ -0,0 +1,59 @@
+/*
+ * batch_planner.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <chrono>
+
+#include "ott/batch_planner.h"
+#include "ott/thread_pool.h"
+
+
+std::vector<BatchResult> solve_batch(const std::vector<TGProblem> &problems, const MatrixXd &MQM, const BatchOptions &options){
+    std::vector<BatchResult> results(problems.size());
+    WorkStealingPool pool(options.num_threads);
+
+    pool.run(problems.size(), [&](int task, int worker){
+        auto t0 = std::chrono::steady_clock::now();
+        const TGProblem &prob = problems[task];
+        BatchResult &res = results[task];
+        res.worker = worker;
+        if(prob.corridor.empty()){
+            res.converge_reason = "Empty corridor";
+            return;
+        }
+        if(MQM.rows() != prob.trajectoryOrder + 1 || MQM.cols() != prob.trajectoryOrder + 1){
+            res.converge_reason = "MQM does not match trajectoryOrder";
+            return;
+        }
+
+        TimeAllocator allocator(prob, MQM, options.settings);
+        allocator.qp.settings = options.qp_settings;
+        for(int p = 0; p < 3; p++)
+            allocator.split_qp.qp[p].settings = options.qp_settings;
+        allocator.split_qp.parallel = false;  // the batch already keeps every core busy
+        allocator.solve_once();
+        res.initial_obj = allocator.obj;
+        if(allocator.is_solved && options.refine){
+            auto flag = allocator.refine_time_by_backtrack();
+            res.is_okay = flag.first;
+            res.converged = flag.second;
+            res.major_iteration = allocator.major_iteration;
+            res.num_prob_solve = allocator.num_prob_solve;
+            res.converge_reason = allocator.converge_reason;
+        }
+        else{
+            res.is_okay = allocator.is_solved;
+            res.converge_reason = allocator.is_solved ? "Not refined" : "Initial solve failed";
+        }
+        res.is_solved = allocator.is_solved;
+        res.obj = allocator.obj;
+        res.room_time = allocator.room_time;
+        res.sol = allocator.sol;
+        res.stats = allocator.stats;
+        res.solve_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    });
+    return results;
+}
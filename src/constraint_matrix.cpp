@@ -0,0 +1,176 @@
+/*
+ * constraint_matrix.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "ott/constraint_matrix.h"
+#include "ott/problem_constructor.h"
+
+
+/* True if the build with all times 2 is the build with all times 1 under the model of ConstraintMatrix: the same pattern
+ * and constraint bounds, variable bounds halved and every value multiplied by exactly 2^power with power in {-1, 0, 1}.
+ * A value 0 in both builds is kept as a constant 0.
+ */
+static bool follows_time_model(const LinearConstr &lincon, const LinearConstr &lincon2, std::vector<int> &power){
+    if(lincon.n_var != lincon2.n_var || lincon.n_con != lincon2.n_con || lincon.n_nnz != lincon2.n_nnz)
+        return false;
+    if(lincon.colptr != lincon2.colptr || lincon.rowind != lincon2.rowind)
+        return false;
+    if(lincon.clb != lincon2.clb || lincon.cub != lincon2.cub)
+        return false;
+    if(lincon2.xlb != 0.5 * lincon.xlb || lincon2.xub != 0.5 * lincon.xub)
+        return false;
+    power.resize(lincon.n_nnz);
+    for(size_t i = 0; i < lincon.n_nnz; i++){
+        double v1 = lincon.values(i), v2 = lincon2.values(i);
+        if(v1 == 0 && v2 == 0)
+            power[i] = 0;
+        else if(v2 == 2 * v1)
+            power[i] = 1;
+        else if(v2 == v1)
+            power[i] = 0;
+        else if(v2 == 0.5 * v1)
+            power[i] = -1;
+        else
+            return false;
+    }
+    return true;
+}
+
+
+ConstraintMatrix::ConstraintMatrix(
+            const vector<pyBox> &corridor,
+            const MatrixXd &MQM,
+            const MatrixXd &pos,
+            const MatrixXd &vel,
+            const MatrixXd &acc,
+            const double maxVel,
+            const double maxAcc,
+            const int traj_order,
+            const double minimize_order,
+            const double margin,
+            const bool & isLimitVel,
+            const bool & isLimitAcc,
+            ProblemWorkspace *ws
+        ){
+    n_seg = corridor.size();
+    s1CtrlP_num = 3 * (traj_order + 1);
+
+    // Build with all times 1 to get the coefficients and with all times 2 to read off the exponents,
+    // this way we stay consistent with construct_A_matrix whatever rows it has.
+    ProblemWorkspace local_ws;
+    ProblemWorkspace &work = ws ? *ws : local_ws;
+    vector<pyBox> probe(corridor);
+    for(auto &box : probe)
+        box.t = 1;
+    lincon = assemble_A_matrix(work, probe, MQM, pos, vel, acc, maxVel, maxAcc, traj_order, minimize_order, margin, isLimitVel, isLimitAcc);
+    for(auto &box : probe)
+        box.t = 2;
+    const LinearConstr &lincon2 = assemble_A_matrix(work, probe, MQM, pos, vel, acc, maxVel, maxAcc, traj_order, minimize_order, margin, isLimitVel, isLimitAcc);
+
+    // both builds have the pattern of the tapes, so their compressed column arrays line up entry by entry
+    int nnz = lincon.n_nnz;
+    if(!follows_time_model(lincon, lincon2, power)){
+        std::cout << "[Error]The constraints do not scale with powers -1, 0, 1 of the segment times, "
+                  << "ConstraintMatrix assembles them in full at every update" << std::endl;
+        reassemble = true;
+        inputs.corridor = corridor;
+        inputs.MQM = MQM;
+        inputs.pos = pos;
+        inputs.vel = vel;
+        inputs.acc = acc;
+        inputs.maxVel = maxVel;
+        inputs.maxAcc = maxAcc;
+        inputs.traj_order = traj_order;
+        inputs.minimize_order = minimize_order;
+        inputs.margin = margin;
+        inputs.isLimitVel = isLimitVel;
+        inputs.isLimitAcc = isLimitAcc;
+        power.clear();
+    }
+    else{
+        seg.resize(nnz);
+        coef.resize(nnz);
+        for(size_t j = 0; j < lincon.n_var; j++){
+            for(int i = lincon.colptr(j); i < lincon.colptr(j + 1); i++){
+                seg[i] = j / s1CtrlP_num;
+                coef[i] = lincon.values(i);
+            }
+        }
+        xlb0 = lincon.xlb;
+        xub0 = lincon.xub;
+    }
+
+    A = Eigen::Map<const SpMX>(lincon.n_con, lincon.n_var, nnz, lincon.colptr.data(), lincon.rowind.data(), lincon.values.data());
+
+    VX room_time(n_seg);
+    for(int k = 0; k < n_seg; k++)
+        room_time(k) = corridor[k].t;
+    update_times(room_time);
+}
+
+
+void ConstraintMatrix::update_times(cRefVX room_time){
+    if(reassemble){
+        for(int k = 0; k < n_seg; k++)
+            inputs.corridor[k].t = room_time(k);
+        const LinearConstr &built = assemble_A_matrix(inputs.work, inputs.corridor, inputs.MQM, inputs.pos, inputs.vel, inputs.acc,
+                inputs.maxVel, inputs.maxAcc, inputs.traj_order, inputs.minimize_order, inputs.margin, inputs.isLimitVel, inputs.isLimitAcc);
+        // the pattern comes from the tapes and does not depend on the times
+        lincon.values = built.values;
+        lincon.xlb = built.xlb;
+        lincon.xub = built.xub;
+        lincon.clb = built.clb;
+        lincon.cub = built.cub;
+        std::copy(built.values.data(), built.values.data() + built.values.size(), A.valuePtr());
+        return;
+    }
+    inv_time = room_time.cwiseInverse();
+    double *Aval = A.valuePtr();
+    int nnz = coef.size();
+    for(int i = 0; i < nnz; i++){
+        double val = coef[i];
+        if(power[i] == 1)
+            val *= room_time(seg[i]);
+        else if(power[i] == -1)
+            val *= inv_time(seg[i]);
+        lincon.values(i) = val;
+        Aval[i] = val;
+    }
+    for(int k = 0; k < n_seg; k++){
+        lincon.xlb.segment(k * s1CtrlP_num, s1CtrlP_num) = xlb0.segment(k * s1CtrlP_num, s1CtrlP_num) * inv_time(k);
+        lincon.xub.segment(k * s1CtrlP_num, s1CtrlP_num) = xub0.segment(k * s1CtrlP_num, s1CtrlP_num) * inv_time(k);
+    }
+}
+
+
+bool ConstraintMatrix::time_derivative(cRefVX room_time, cRefVX dtime, SpMX &dA, VX &dxlb, VX &dxub) const{
+    if(reassemble)
+        return false;
+    dA = A;
+    double *dval = dA.valuePtr();
+    int nnz = coef.size();
+    for(int i = 0; i < nnz; i++){
+        int k = seg[i];
+        double d = 0;
+        if(power[i] == 1)
+            d = coef[i] * dtime(k);
+        else if(power[i] == -1)
+            d = -coef[i] * dtime(k) / (room_time(k) * room_time(k));
+        dval[i] = d;
+    }
+    dxlb.resize(lincon.xlb.size());
+    dxub.resize(lincon.xub.size());
+    for(int k = 0; k < n_seg; k++){
+        double rate = -dtime(k) / (room_time(k) * room_time(k));
+        dxlb.segment(k * s1CtrlP_num, s1CtrlP_num) = xlb0.segment(k * s1CtrlP_num, s1CtrlP_num) * rate;
+        dxub.segment(k * s1CtrlP_num, s1CtrlP_num) = xub0.segment(k * s1CtrlP_num, s1CtrlP_num) * rate;
+    }
+    return true;
+}
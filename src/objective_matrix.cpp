@@ -0,0 +1,70 @@
+/*
+ * objective_matrix.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include "ott/objective_matrix.h"
+#include "ott/problem_constructor.h"
+#include "ott/order_kernels.h"
+
+
+ObjectiveMatrix::ObjectiveMatrix(double minimize_order_, int segment_num, int poly_order, cRefVX room_time, cRefMX MQM, const std::string &type):
+    minimize_order(minimize_order_),
+    n_seg(segment_num)
+{
+    // at unit times every block is exactly MQM
+    VX unit_time = VX::Ones(segment_num);
+    MatrixXd MQM_ = MQM;
+    std::string type_ = type;
+    auto trip = construct_P_matrix(minimize_order, segment_num, poly_order, unit_time, MQM_, type_);
+    const VX &pval = std::get<0>(trip);
+    const lVX &prow = std::get<1>(trip), &pcol = std::get<2>(trip);
+
+    int n_var = segment_num * 3 * (poly_order + 1);
+    std::vector<Eigen::Triplet<double> > triplets;
+    triplets.reserve(pval.size());
+    for(int i = 0; i < pval.size(); i++)
+        triplets.push_back(Eigen::Triplet<double>(prow(i), pcol(i), pval(i)));
+    P.resize(n_var, n_var);
+    P.setFromTriplets(triplets.begin(), triplets.end());
+    P.makeCompressed();
+    base_val = Eigen::Map<VX>(P.valuePtr(), P.nonZeros());
+
+    int s1CtrlP_num = 3 * (poly_order + 1);
+    seg_begin.resize(segment_num + 1);
+    for(int k = 0; k <= segment_num; k++)
+        seg_begin[k] = P.outerIndexPtr()[k * s1CtrlP_num];
+
+    update_times(room_time);
+}
+
+
+double ObjectiveMatrix::segment_scale(double minimize_order, double t){
+    return time_scale(minimize_order, t).val;
+}
+
+
+void ObjectiveMatrix::update_times(cRefVX room_time){
+    double *val = P.valuePtr();
+    for(int k = 0; k < n_seg; k++){
+        int begin = seg_begin[k], len = seg_begin[k + 1] - seg_begin[k];
+        Eigen::Map<VX>(val + begin, len) = segment_scale(minimize_order, room_time(k)) * base_val.segment(begin, len);
+    }
+}
+
+
+SpMX ObjectiveMatrix::time_derivative(cRefVX room_time, cRefVX dtime) const{
+    SpMX dP = P;
+    double *val = dP.valuePtr();
+    for(int k = 0; k < n_seg; k++){
+        int begin = seg_begin[k], len = seg_begin[k + 1] - seg_begin[k];
+        double rate = time_scale(minimize_order, room_time(k)).dvdt * dtime(k);
+        Eigen::Map<VX>(val + begin, len) = rate * base_val.segment(begin, len);
+    }
+    return dP;
+}
@@ -0,0 +1,121 @@
+/*
+ * order_kernels.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <cmath>
+
+#include "ott/order_kernels.h"
+
+
+TimeScale time_scale(double minimize_order, double t){
+    int min_order_l = floor(minimize_order);
+    int min_order_u = ceil (minimize_order);
+    TimeScale sc;
+    if (min_order_l == min_order_u){
+        sc.val = 1.0 / pow(t, 2 * min_order_u - 3);
+        sc.dvdt = (3 - 2 * min_order_u) / pow(t, 2 * min_order_u - 2);
+    }
+    else{
+        sc.val = (minimize_order - min_order_l) / pow(t, 2 * min_order_u - 3)
+                 + (min_order_u - minimize_order) / pow(t, 2 * min_order_l - 3);
+        sc.dvdt = (minimize_order - min_order_l) / pow(t, 2 * min_order_u - 2) * (3 - 2 * min_order_u)
+                  + (min_order_u - minimize_order) / pow(t, 2 * min_order_l - 2) * (3 - 2 * min_order_l);
+    }
+    return sc;
+}
+
+
+/* N is traj_order + 1 or Eigen::Dynamic, in the latter case n_poly gives the size.
+ * The coefficients of a segment are viewed as an N x 3 block, one column per axis, so one fixed size product
+ * MQM * X gives the gradient of all three axes and the cost comes from the same product.
+ * Eigen vectorizes these products with whatever SIMD the build enables (SSE2 by default, AVX2 with OTT_AVX2).
+ */
+template<int N>
+static double cost_with_grad_kernel(int n_poly, cRefVX coef, cRefVX room_time, double minimize_order, cRefMX MQM, RefVX G, bool needg){
+    typedef Eigen::Matrix<double, N, N> MatN;
+    typedef Eigen::Matrix<double, N, 3> MatN3;
+    const MatN M = MQM.topLeftCorner(n_poly, n_poly);
+    int segment_num = room_time.size();
+    int s1CtrlP_num = 3 * n_poly;
+    int n_coef = s1CtrlP_num * segment_num;
+
+    double cost = 0;
+    MatN3 Y(n_poly, 3);
+    for(int k = 0; k < segment_num; k++){
+        TimeScale sc = time_scale(minimize_order, room_time(k));
+        Eigen::Map<const MatN3> X(coef.data() + k * s1CtrlP_num, n_poly, 3);
+        Y.noalias() = M * X;
+        double quad = X.cwiseProduct(Y).sum();  // sum over the axes of x' MQM x
+        cost += 0.5 * sc.val * quad;
+        if(needg){
+            Eigen::Map<MatN3>(G.data() + k * s1CtrlP_num, n_poly, 3) = sc.val * Y;
+            G(n_coef + k) = 0.5 * sc.dvdt * quad;
+        }
+    }
+    return cost;
+}
+
+
+template<int N>
+static void gradient_from_P_kernel(int n_poly, cRefVX room_time, double minimize_order, cRefMX MQM, cRefVX sol, RefVX pgrad){
+    typedef Eigen::Matrix<double, N, N> MatN;
+    typedef Eigen::Matrix<double, N, 3> MatN3;
+    const MatN M = MQM.topLeftCorner(n_poly, n_poly);
+    int s1CtrlP_num = 3 * n_poly;
+    MatN3 Y(n_poly, 3);
+    for(int k = 0; k < room_time.size(); k++){
+        Eigen::Map<const MatN3> X(sol.data() + k * s1CtrlP_num, n_poly, 3);
+        Y.noalias() = M * X;
+        pgrad(k) = 0.5 * time_scale(minimize_order, room_time(k)).dvdt * X.cwiseProduct(Y).sum();
+    }
+}
+
+
+template<int N>
+static void fill_P_kernel(int n_poly, cRefVX room_time, double minimize_order, cRefMX MQM, char type, RefVX qval, ReflVX qsubi, ReflVX qsubj){
+    typedef Eigen::Matrix<double, N, N> MatN;
+    const MatN M = MQM.topLeftCorner(n_poly, n_poly);
+    bool lower = type == 'l' || type == 'L', upper = type == 'u' || type == 'U', full = type == 'f' || type == 'F';
+    if(!lower && !upper && !full)
+        return;
+    int s1CtrlP_num = 3 * n_poly;
+    int idx = 0;
+    for(int k = 0; k < room_time.size(); k++){
+        double scale = time_scale(minimize_order, room_time(k)).val;
+        for(int p = 0; p < 3; p++){
+            int shift = k * s1CtrlP_num + p * n_poly;
+            for(int i = 0; i < n_poly; i++){
+                int j_begin = upper ? i : 0, j_end = lower ? i + 1 : n_poly;
+                for(int j = j_begin; j < j_end; j++){
+                    qsubi(idx) = shift + i;
+                    qsubj(idx) = shift + j;
+                    qval(idx) = scale * M(i, j);
+                    idx++;
+                }
+            }
+        }
+    }
+}
+
+
+template<int N>
+static OrderKernels make_kernels(int traj_order){
+    OrderKernels kernels;
+    kernels.traj_order = traj_order;
+    kernels.cost_with_grad = &cost_with_grad_kernel<N>;
+    kernels.gradient_from_P = &gradient_from_P_kernel<N>;
+    kernels.fill_P = &fill_P_kernel<N>;
+    return kernels;
+}
+
+
+const OrderKernels &order_kernels(int traj_order){
+    static const OrderKernels table[] = {make_kernels<6>(5), make_kernels<7>(6), make_kernels<8>(7), make_kernels<9>(8)};
+    static const OrderKernels generic = make_kernels<Eigen::Dynamic>(-1);
+    if(traj_order >= 5 && traj_order <= 8)
+        return table[traj_order - 5];
+    return generic;
+}
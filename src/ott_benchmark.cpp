@@ -0,0 +1,215 @@
+/*
+ * ott_benchmark.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+/* Time each stage of the planner on the problems of the dataset and print the results as JSON.
+ * Usage: ott_benchmark [dataset_dir] [repeat] [refine_repeat]
+ * dataset_dir defaults to dataset, every tgp_i.tgp from i = 0 on is used until one is missing. Each stage is run
+ * repeat times (20 by default) per problem, the full refinement refine_repeat times (3 by default), and the median
+ * of the runs is kept. The summary gives the median and the 95th percentile of those over the problems, in
+ * microseconds. Problems are set up as in solveProblem of spatialSolver.py: jerk, 6th order, no velocity limit.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "ott/TGProblem.h"
+#include "ott/bezier_base.h"
+#include "ott/problem_constructor.h"
+#include "ott/time_allocator.h"
+
+
+static const char *STAGES[] = {"load", "bernstein", "construct_P", "construct_A", "gradient_from_P", "gradient_from_A",
+                               "eval_f", "snopt_eval", "refine"};
+static const int NUM_STAGE = sizeof(STAGES) / sizeof(STAGES[0]);
+enum Stage {LOAD, BERNSTEIN, CONSTRUCT_P, CONSTRUCT_A, GRADIENT_P, GRADIENT_A, EVAL_F, SNOPT_EVAL, REFINE};
+
+
+// nearest rank percentile, q in [0, 1]
+static double percentile(std::vector<double> v, double q){
+    if(v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    size_t idx = std::min(v.size() - 1, (size_t)(q * v.size()));
+    return v[idx];
+}
+
+
+// median run time of fn in microseconds
+template<typename Fn>
+static double time_median(int repeat, Fn fn){
+    std::vector<double> runs(repeat);
+    for(int r = 0; r < repeat; r++){
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        runs[r] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+    }
+    return percentile(runs, 0.5);
+}
+
+
+struct ProblemResult{
+    int index = 0;
+    int segments = 0;
+    size_t n_var = 0, n_con = 0, nnz = 0;
+    int major_iteration = 0;
+    int num_prob_solve = 0;
+    double obj = 0;
+    bool converged = false;
+    double stage_us[NUM_STAGE];
+};
+
+
+static ProblemResult run_problem(const std::string &file, int index, int repeat, int refine_repeat){
+    ProblemResult res;
+    res.index = index;
+    TGProblem tgp;
+    res.stage_us[LOAD] = time_median(repeat, [&](){
+        TGProblem loaded;
+        loadTGProblemFromFile(file, loaded);
+        tgp = loaded;
+    });
+    tgp.doLimitVelocity = false;
+    tgp.minimizeOrder = 3;
+    tgp.trajectoryOrder = 6;
+    int order = tgp.trajectoryOrder;
+
+    // a fresh object each time, as each planner constructs its own
+    MatrixXd MQM;
+    res.stage_us[BERNSTEIN] = time_median(repeat, [&](){
+        Bernstein bz;
+        bz.setParam(order, order, tgp.minimizeOrder);
+        MQM = bz.getMQM()[order];
+    });
+
+    std::vector<pyBox> corridor;
+    for(auto &box : tgp.corridor)
+        corridor.push_back(pyBox(box));
+    int segment_num = corridor.size();
+    VX room_time(segment_num);
+    for(int i = 0; i < segment_num; i++)
+        room_time(i) = corridor[i].t;
+    res.segments = segment_num;
+
+    std::string type = "L";
+    res.stage_us[CONSTRUCT_P] = time_median(repeat, [&](){
+        construct_P_matrix(tgp.minimizeOrder, segment_num, order, room_time, MQM, type);
+    });
+    auto build_A = [&](){
+        return construct_A_matrix(corridor, MQM, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity,
+                tgp.maxAcceleration, order, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration);
+    };
+    LinearConstr lincon = build_A();
+    res.stage_us[CONSTRUCT_A] = time_median(repeat, [&](){
+        lincon = build_A();
+    });
+    res.n_var = lincon.n_var;
+    res.n_con = lincon.n_con;
+    res.nnz = lincon.n_nnz;
+
+    // the gradients and the evaluations are timed at the solution with the initial times
+    TimeAllocator allocator(tgp, MQM);
+    allocator.solve_once();
+    VX sol = allocator.sol, lmdy = allocator.lmdy, lmdz = allocator.lmdz;
+    if(!allocator.is_solved){
+        sol = VX::Zero(lincon.n_var);
+        lmdy = VX::Zero(lincon.n_con);
+        lmdz = VX::Zero(lincon.n_var);
+    }
+    res.stage_us[GRADIENT_P] = time_median(repeat, [&](){
+        gradient_from_P(tgp.minimizeOrder, segment_num, order, room_time, MQM, sol);
+    });
+    res.stage_us[GRADIENT_A] = time_median(repeat, [&](){
+        gradient_from_A(corridor, MQM, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity, tgp.maxAcceleration,
+                order, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration, sol, lmdy, lmdz);
+    });
+    res.stage_us[EVAL_F] = time_median(repeat, [&](){
+        eval_f(sol, room_time, order, tgp.minimizeOrder, MQM, true);
+    });
+
+    // rows are the cost, the linear constraints, the corridor bounds and the total time; in the gradient a linear row
+    // has its nonzeros and at most two times, a bound row one coefficient and one time
+    int n_F = 1 + lincon.n_con + lincon.n_var + 1;
+    int n_G = (lincon.n_var + segment_num) + (lincon.n_nnz + 2 * lincon.n_con) + 2 * lincon.n_var + segment_num;
+    VX F(n_F), lb(n_F), ub(n_F), G(n_G);
+    lVX row(n_G), col(n_G);
+    res.stage_us[SNOPT_EVAL] = time_median(repeat, [&](){
+        snopt_eval(corridor, MQM, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity, tgp.maxAcceleration,
+                order, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration,
+                sol, F, lb, ub, G, row, col, true, true, true);
+    });
+
+    TimeAllocatorSettings settings;
+    settings.max_iter = 100;
+    settings.adaptive_line_search = true;
+    res.stage_us[REFINE] = time_median(refine_repeat, [&](){
+        TimeAllocator refiner(tgp, MQM, settings);
+        refiner.solve_once();
+        res.converged = refiner.refine_time_by_backtrack().second;
+        res.major_iteration = refiner.major_iteration;
+        res.num_prob_solve = refiner.num_prob_solve;
+        res.obj = refiner.obj;
+    });
+    return res;
+}
+
+
+static bool file_exists(const std::string &file){
+    std::ifstream ifs(file);
+    return ifs.good();
+}
+
+
+int main(int argc, char **argv){
+    std::string dir = argc > 1 ? argv[1] : "dataset";
+    int repeat = argc > 2 ? std::max(1, atoi(argv[2])) : 20;
+    int refine_repeat = argc > 3 ? std::max(1, atoi(argv[3])) : 3;
+
+    std::vector<ProblemResult> results;
+    for(int i = 0; ; i++){
+        std::string file = dir + "/tgp_" + std::to_string(i) + ".tgp";
+        if(!file_exists(file))
+            break;
+        results.push_back(run_problem(file, i, repeat, refine_repeat));
+    }
+    if(results.empty()){
+        cout << "[Error]No problem found in " << dir << endl;
+        return 1;
+    }
+
+    printf("{\n  \"dataset\": \"%s\",\n  \"repeat\": %d,\n  \"refine_repeat\": %d,\n  \"num_problem\": %d,\n",
+           dir.c_str(), repeat, refine_repeat, (int)results.size());
+    printf("  \"stages\": {\n");
+    for(int s = 0; s < NUM_STAGE; s++){
+        std::vector<double> us;
+        for(auto &res : results)
+            us.push_back(res.stage_us[s]);
+        printf("    \"%s\": {\"median_us\": %.3f, \"p95_us\": %.3f}%s\n", STAGES[s], percentile(us, 0.5), percentile(us, 0.95),
+               s + 1 < NUM_STAGE ? "," : "");
+    }
+    printf("  },\n  \"problems\": [\n");
+    for(size_t i = 0; i < results.size(); i++){
+        const ProblemResult &res = results[i];
+        printf("    {\"index\": %d, \"segments\": %d, \"n_var\": %d, \"n_con\": %d, \"nnz\": %d, \"major_iteration\": %d, "
+               "\"num_prob_solve\": %d, \"converged\": %s", res.index, res.segments, (int)res.n_var,
+               (int)res.n_con, (int)res.nnz, res.major_iteration, res.num_prob_solve, res.converged ? "true" : "false");
+        if(std::isfinite(res.obj))  // JSON has no inf
+            printf(", \"obj\": %.10g", res.obj);
+        else
+            printf(", \"obj\": null");
+        for(int s = 0; s < NUM_STAGE; s++)
+            printf(", \"%s_us\": %.3f", STAGES[s], res.stage_us[s]);
+        printf("}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
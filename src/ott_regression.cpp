@@ -0,0 +1,631 @@
+/*
+ * ott_regression.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+/* Solve a few problems of the dataset with QPSolver and BandedIPMSolver and check them against each other.
+ * Usage: ott_regression [dataset_dir] [stride]
+ * Every stride-th tgp_i.tgp (20 by default) from i = 0 on is used until one is missing, set up as in ott_benchmark.
+ * Each solution must satisfy the KKT conditions, both must reach the same objective and gradient_from_A must give
+ * the same gradient from either set of multipliers. QPSolver with Ruiz scaling must reach that objective too, and a
+ * solve that stops early must not leave the previous solution behind. TimeAllocator::get_hessian must agree with
+ * differences of get_gradient. tgp_30 with the settings of its file is pinned as a problem ADMM needs more than the
+ * default iterations for. Assembling the constraints again into a ProblemWorkspace,
+ * updating a ConstraintMatrix and calling gradient_from_A and snopt_eval again with a workspace must not allocate.
+ * Against the code or formula they replaced: the binary format must give back the problem of the text archive,
+ * sliceCorridor the corridor of the old in place slicing bit for bit, TrajectoryEvaluator the Bezier curves of the
+ * solutions at orders 6 and 7, and the Bernstein tables the binomials, mapping matrices and monomial M'QM.
+ * Prints one line per problem or check and returns 1 if any check fails.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "ott/TGProblem.h"
+#include "ott/bezier_base.h"
+#include "ott/problem_constructor.h"
+#include "ott/problem_workspace.h"
+#include "ott/objective_matrix.h"
+#include "ott/constraint_matrix.h"
+#include "ott/qp_solver.h"
+#include "ott/banded_ipm.h"
+#include "ott/time_allocator.h"
+#include "ott/tgp_binary.h"
+#include "ott/trajectory_evaluator.h"
+
+
+static const double KKT_TOL = 1e-5;  // on residuals relative to the terms they balance
+static const double OBJ_TOL = 1e-4;  // ADMM stops at its tolerances, a few problems end that far above the optimum
+static const double GRAD_TOL = 1e-3;  // the multipliers of ADMM are less accurate than the solution
+static const double HESS_TOL = 5e-2;  // the reference carries the tolerances of its solves and kinks if the active set changes
+static const double SCALED_KKT_TOL = 1e-4;  // with Ruiz scaling polishing often fails and ADMM stops at its tolerances
+static const double CURVE_TOL = 1e-12;  // relative to the sum of the magnitudes of the monomial terms
+static const double MQM_TOL = 1e-7;  // the monomial M'QM the tables replaced loses a digit per order, 2e-8 at order 12
+static const double EVAL_TOL = 1e-12;  // Horner in the time since the segment start against de Casteljau in s
+
+
+/* Heap allocations while count_alloc is set. Eigen allocates with malloc and the std containers with operator new,
+ * which ends in malloc as well, so with glibc malloc itself is counted; elsewhere only operator new is seen.
+ */
+static bool count_alloc = false;
+static long num_alloc = 0;
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t num, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size){
+    if(count_alloc)
+        num_alloc++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t num, size_t size){
+    if(count_alloc)
+        num_alloc++;
+    return __libc_calloc(num, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size){
+    if(count_alloc)
+        num_alloc++;
+    return __libc_realloc(ptr, size);
+}
+#else
+void *operator new(size_t size){
+    if(count_alloc)
+        num_alloc++;
+    void *ptr = std::malloc(size ? size : 1);
+    if(!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {std::free(ptr);}
+void operator delete(void *ptr, size_t) noexcept {std::free(ptr);}
+#endif
+
+
+// heap allocations of one call of fn
+template<typename Fn>
+static long allocations(Fn fn){
+    num_alloc = 0;
+    count_alloc = true;
+    fn();
+    count_alloc = false;
+    return num_alloc;
+}
+
+
+// relative KKT residuals of Px + A'lmdy + lmdz = 0 with the sign convention of QPSolver
+struct KKTResidual{
+    double stationarity = 0;
+    double primal = 0;
+    double complementarity = 0;  // relative to the cost, also catches multipliers of the wrong sign
+
+    double worst() const {return std::max(stationarity, std::max(primal, complementarity));}
+};
+
+
+// a positive multiplier holds the value at its upper bound, a negative one at its lower bound
+static double complementarity(cRefVX val, cRefVX lmd, cRefVX lb, cRefVX ub){
+    double worst = 0;
+    for(int i = 0; i < val.size(); i++){
+        double gap = lmd(i) > 0 ? ub(i) - val(i) : val(i) - lb(i);
+        if(std::abs(gap) > 1e19)  // no bound on that side, so no multiplier either
+            gap = 1;
+        worst = std::max(worst, std::abs(lmd(i) * gap));
+    }
+    return worst;
+}
+
+
+static KKTResidual kkt_residual(const SpMX &P, const ConstraintMatrix &constraint, cRefVX x, cRefVX lmdy, cRefVX lmdz){
+    const LinearConstr &lincon = constraint.lincon;
+    KKTResidual res;
+    VX Px = P.selfadjointView<Eigen::Lower>() * x;
+    VX Aty = constraint.A.transpose() * lmdy;
+    double scale = std::max(1.0, std::max(Px.lpNorm<Eigen::Infinity>(),
+                std::max(Aty.lpNorm<Eigen::Infinity>(), lmdz.lpNorm<Eigen::Infinity>())));
+    res.stationarity = (Px + Aty + lmdz).lpNorm<Eigen::Infinity>() / scale;
+    VX Ax = constraint.A * x;
+    double violation = std::max((lincon.clb - Ax).maxCoeff(), (Ax - lincon.cub).maxCoeff());
+    violation = std::max(violation, std::max((lincon.xlb - x).maxCoeff(), (x - lincon.xub).maxCoeff()));
+    res.primal = std::max(violation, 0.0) / std::max(1.0, std::max(Ax.lpNorm<Eigen::Infinity>(), x.lpNorm<Eigen::Infinity>()));
+    res.complementarity = std::max(complementarity(Ax, lmdy, lincon.clb, lincon.cub),
+                                   complementarity(x, lmdz, lincon.xlb, lincon.xub)) / std::max(1.0, x.dot(Px));
+    return res;
+}
+
+
+static double rel_diff(cRefVX a, cRefVX b){
+    return (a - b).norm() / std::max(1.0, a.norm());
+}
+
+
+/* Relative difference of get_hessian from central differences of get_gradient between solves at room_time -+ h e_k,
+ * with h 1e-3 of room k, each one on a copy of allocator so all start from its solution. NaN if a solve fails.
+ */
+static double hessian_diff(const TimeAllocator &allocator){
+    TimeAllocator base = allocator;
+    int n_room = base.room_time.size();
+    MatrixXd H, H_ref(n_room, n_room);
+    if(!base.get_hessian(H))
+        return std::numeric_limits<double>::quiet_NaN();
+    for(int k = 0; k < n_room; k++){
+        double h = 1e-3 * base.room_time(k);
+        TimeAllocator forward = allocator, backward = allocator;
+        VX t_forward = allocator.room_time, t_backward = allocator.room_time;
+        t_forward(k) += h;
+        t_backward(k) -= h;
+        if(!forward.solve_with_room_time(t_forward) || !backward.solve_with_room_time(t_backward))
+            return std::numeric_limits<double>::quiet_NaN();
+        H_ref.col(k) = (forward.get_gradient() - backward.get_gradient()) / (2 * h);
+    }
+    MatrixXd H_sym = 0.5 * (H_ref + H_ref.transpose());
+    return (H - H_sym).norm() / std::max(1.0, H_sym.norm());
+}
+
+
+static bool file_exists(const std::string &file){
+    std::ifstream ifs(file);
+    return ifs.good();
+}
+
+
+// n choose k by the multiplicative formula, exact in int64 up to n = 40
+static int64_t choose(int n, int k){
+    int64_t c = 1;
+    for(int i = 1; i <= k; i++)
+        c = c * (n - k + i) / i;
+    return c;
+}
+
+
+// n! / (n - r)!
+static double falling_factorial(int n, int r){
+    double f = 1;
+    for(int i = 0; i < r; i++)
+        f *= n - i;
+    return f;
+}
+
+
+// the Bezier curve of the control points at s
+static double de_casteljau(std::vector<double> ctrl, double s){
+    for(int k = (int)ctrl.size() - 1; k > 0; k--){
+        for(int i = 0; i < k; i++)
+            ctrl[i] = (1 - s) * ctrl[i] + s * ctrl[i + 1];
+    }
+    return ctrl.empty() ? 0 : ctrl[0];
+}
+
+
+/* The Bernstein tables against the formulas they are built from, with the binomials computed at run time. M of every
+ * order up to BEZIER_MAX_ORDER must hold (-1)^(i - j) C(n, i) C(i, j) exactly and give the Bezier curve of its control
+ * points; the hand written matrix of order 7 had one entry of the wrong sign. Up to order 12, where the hand written
+ * matrices stopped, MQM must match M'QM with the cost Hessian Q of the monomial coefficients it was computed from before.
+ */
+static bool check_bernstein(){
+    bool tables_ok = true;
+    for(int n = 0; n <= 2 * BEZIER_MAX_ORDER; n++){
+        for(int k = 0; k <= n; k++)
+            tables_ok = tables_ok && BERNSTEIN_TABLES.binomial[n][k] == choose(n, k);
+    }
+    for(int n = 0; n <= BEZIER_MAX_ORDER; n++){
+        for(int r = 0; r <= n; r++)
+            tables_ok = tables_ok && BERNSTEIN_TABLES.falling[n][r] == falling_factorial(n, r);
+    }
+
+    Bernstein bz(0, BEZIER_MAX_ORDER, 3);
+    std::vector<MatrixXd> M = bz.getM();
+    double curve_diff = 0;
+    for(int n = 0; n <= BEZIER_MAX_ORDER; n++){
+        for(int i = 0; i <= n; i++){
+            for(int j = 0; j <= n; j++){
+                double ref = j > i ? 0 : ((i - j) % 2 ? -1.0 : 1.0) * double(choose(n, i) * choose(i, j));
+                tables_ok = tables_ok && M[n](i, j) == ref;
+            }
+        }
+        std::vector<double> ctrl(n + 1);
+        for(int j = 0; j <= n; j++)
+            ctrl[j] = std::sin(j + 1.0);
+        VX mono = M[n] * Eigen::Map<VX>(ctrl.data(), n + 1);
+        for(double s : {0.0, 0.3, 0.7, 1.0}){
+            double val = 0, mag = 0, power = 1;
+            for(int i = 0; i <= n; i++){
+                val += mono(i) * power;
+                mag += std::abs(mono(i) * power);
+                power *= s;
+            }
+            curve_diff = std::max(curve_diff, std::abs(val - de_casteljau(ctrl, s)) / std::max(1.0, mag));
+        }
+    }
+
+    double mqm_diff = 0;
+    for(int r = 2; r <= 3; r++){
+        Bernstein bz_r(0, 12, r);
+        std::vector<MatrixXd> MQM = bz_r.getMQM();
+        for(int n = 0; n <= 12; n++){
+            MatrixXd Q = MatrixXd::Zero(n + 1, n + 1);
+            for(int i = r; i <= n; i++){
+                for(int j = r; j <= n; j++)
+                    Q(i, j) = falling_factorial(i, r) * falling_factorial(j, r) / (i + j - 2 * r + 1);
+            }
+            MatrixXd ref = M[n].transpose() * Q * M[n];
+            mqm_diff = std::max(mqm_diff, (MQM[n] - ref).norm() / std::max(1.0, ref.norm()));
+        }
+    }
+
+    bool ok = tables_ok && curve_diff < CURVE_TOL && mqm_diff < MQM_TOL;
+    printf("bernstein orders 0 to %d tables %s curve_diff %.1e MQM_diff %.1e %s\n", BEZIER_MAX_ORDER,
+           tables_ok ? "ok" : "wrong", curve_diff, mqm_diff, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+
+static bool same_matrix(const MatrixXd &a, const MatrixXd &b){
+    return a.rows() == b.rows() && a.cols() == b.cols() && (a.array() == b.array()).all();
+}
+
+
+static bool same_box(const Box &a, const Box &b){
+    return a.box == b.box && a.t == b.t && a.center == b.center && same_matrix(a.vertex, b.vertex) && a.valid == b.valid;
+}
+
+
+static bool same_problem(const TGProblem &a, const TGProblem &b){
+    if(a.corridor.size() != b.corridor.size())
+        return false;
+    for(size_t i = 0; i < a.corridor.size(); i++){
+        if(!same_box(a.corridor[i], b.corridor[i]))
+            return false;
+    }
+    return same_matrix(a.MQM, b.MQM) && same_matrix(a.position, b.position) && same_matrix(a.velocity, b.velocity)
+        && same_matrix(a.acceleration, b.acceleration) && a.maxVelocity == b.maxVelocity
+        && a.maxAcceleration == b.maxAcceleration && a.trajectoryOrder == b.trajectoryOrder
+        && a.minimizeOrder == b.minimizeOrder && a.margin == b.margin && a.doLimitVelocity == b.doLimitVelocity
+        && a.doLimitAcceleration == b.doLimitAcceleration;
+}
+
+
+// tgp written with saveTGProblemToBinary next to file and read back by both readers must be the problem the text archive gave
+static bool check_binary(const TGProblem &tgp, const std::string &file){
+    std::string binary = file + ".regression.tgpb";
+    TGProblem loaded, mapped;
+    bool ok = saveTGProblemToBinary(tgp, binary) && loadTGProblemFromBinary(binary, loaded);
+    if(ok){
+        TGProblemView view(binary);
+        ok = view.is_open();
+        if(ok)
+            view.to_problem(mapped);
+    }
+    std::remove(binary.c_str());
+    return ok && same_problem(tgp, loaded) && same_problem(tgp, mapped);
+}
+
+
+/* sliceCorridor as it was before it built the new corridor in one pass: the middle boxes are sliced one at a time in
+ * place, and once every box of a round is sliced it starts over from the second box of the grown corridor.
+ */
+static bool slice_corridor_baseline(std::vector<Box> &corridor, std::vector<char> sliceDirections, unsigned sliceTimes){
+    unsigned corridorLength = corridor.size();
+    unsigned whichToSlice = 1, localSliceTimes = 0;
+    for(unsigned i = 0; i < sliceTimes; i++){
+        Box &boxToSlice = corridor[whichToSlice];
+        boxToSlice.setBox();
+        std::vector<std::pair<double, double> > bound1, bound2;
+        if(!boxToSlice.sliceIntoTwo(sliceDirections[whichToSlice], bound1, bound2))
+            return false;
+        Box halves[2] = {Box(bound1), Box(bound2)};
+        for(Box &half : halves){
+            half.setBox();
+            half.t = boxToSlice.t / 2;
+        }
+        corridor.erase(corridor.begin() + whichToSlice);
+        corridor.insert(corridor.begin() + whichToSlice, halves, halves + 2);
+        sliceDirections.insert(sliceDirections.begin() + whichToSlice, sliceDirections[whichToSlice]);
+        whichToSlice += 2;
+        localSliceTimes++;
+        if(localSliceTimes >= corridorLength - 2){
+            localSliceTimes = 0;
+            whichToSlice = 1;
+            corridorLength = corridor.size();
+        }
+    }
+    return true;
+}
+
+
+// sliceCorridor must give bit for bit the corridor of the baseline, for a few slice counts and all three axes
+static bool check_slicing(const TGProblem &tgp){
+    if(tgp.corridor.size() <= 2)
+        return true;
+    std::vector<char> directions;
+    for(size_t i = 0; i < tgp.corridor.size(); i++)
+        directions.push_back("xyz"[i % 3]);
+    for(unsigned slice_times : {1u, 2u, 5u, 13u}){
+        TGProblem sliced = tgp;
+        std::vector<Box> reference = tgp.corridor;
+        if(!sliceCorridor(sliced, directions, slice_times) || !slice_corridor_baseline(reference, directions, slice_times))
+            return false;
+        if(sliced.corridor.size() != reference.size())
+            return false;
+        for(size_t i = 0; i < reference.size(); i++){
+            if(!same_box(sliced.corridor[i], reference[i]))
+                return false;
+        }
+    }
+    return true;
+}
+
+
+/* Largest difference of TrajectoryEvaluator from the Bezier curves of sol, evaluated by de Casteljau on the differences
+ * of the control points. The high derivatives cancel most of the digits of the control points in either form, so each
+ * derivative is compared relative to the bound 2^d max |control point| its differences can reach. Derivatives up to one
+ * above the order are compared inside each segment and at both ends, with the times sorted and reversed.
+ */
+static double evaluator_diff(const MatrixXd &M, cRefVX sol, cRefVX room_time){
+    int order = M.rows() - 1, n_ctrl = order + 1, n_seg = room_time.size(), max_deriv = order + 1;
+    int n_out = 3 * (max_deriv + 1);
+    std::vector<double> times, ref, scale(max_deriv + 1, 1.0);
+    auto add = [&](int seg, double t, double s){
+        times.push_back(t);
+        for(int d = 0; d <= max_deriv; d++){
+            for(int axis = 0; axis < 3; axis++){
+                if(d > order){
+                    ref.push_back(0);
+                    continue;
+                }
+                std::vector<double> ctrl(sol.data() + n_ctrl * (3 * seg + axis), sol.data() + n_ctrl * (3 * seg + axis + 1));
+                double ctrl_max = 0;
+                for(double c : ctrl)
+                    ctrl_max = std::max(ctrl_max, std::abs(c));
+                for(int k = 0; k < d; k++){
+                    for(int j = 0; j + k + 1 < n_ctrl; j++)
+                        ctrl[j] = ctrl[j + 1] - ctrl[j];
+                }
+                ctrl.resize(n_ctrl - d);
+                // sol is scaled by 1 / room_time and s by room_time per derivative
+                double factor = room_time(seg) * falling_factorial(order, d) / std::pow(room_time(seg), d);
+                ref.push_back(factor * de_casteljau(ctrl, s));
+                scale[d] = std::max(scale[d], factor * std::pow(2.0, d) * ctrl_max);
+            }
+        }
+    };
+    add(0, 0, 0);
+    double start = 0;
+    for(int k = 0; k < n_seg; k++){
+        for(double s : {0.1, 0.5, 0.9})
+            add(k, start + s * room_time(k), s);
+        start += room_time(k);
+    }
+    add(n_seg - 1, start, 1);
+
+    TrajectoryEvaluator evaluator(M, sol, room_time);
+    int n = times.size();
+    std::vector<double> out(n * n_out), out_reversed(n * n_out), times_reversed(times.rbegin(), times.rend());
+    evaluator.evaluate(times.data(), n, max_deriv, out.data());
+    evaluator.evaluate(times_reversed.data(), n, max_deriv, out_reversed.data());
+
+    double diff = 0;
+    for(int q = 0; q < n; q++){
+        for(int c = 0; c < n_out; c++){
+            double err = std::max(std::abs(out[q * n_out + c] - ref[q * n_out + c]),
+                    std::abs(out_reversed[(n - 1 - q) * n_out + c] - ref[q * n_out + c]));
+            diff = std::max(diff, err / scale[c / 3]);
+        }
+    }
+    return diff;
+}
+
+
+// returns true if every check passes
+static bool check_problem(const std::string &file, int index){
+    TGProblem tgp;
+    loadTGProblemFromFile(file, tgp);
+    bool binary_ok = check_binary(tgp, file);
+    bool slice_ok = check_slicing(tgp);
+    tgp.doLimitVelocity = false;
+    tgp.minimizeOrder = 3;
+    tgp.trajectoryOrder = 6;
+    int order = tgp.trajectoryOrder;
+    Bernstein bz;
+    bz.setParam(order, order, tgp.minimizeOrder);
+    MatrixXd MQM = bz.getMQM()[order];
+
+    std::vector<pyBox> corridor;
+    for(auto &box : tgp.corridor)
+        corridor.push_back(pyBox(box));
+    int segment_num = corridor.size();
+    VX room_time(segment_num);
+    for(int i = 0; i < segment_num; i++)
+        room_time(i) = corridor[i].t;
+
+    // ProblemWorkspace::num_alloc only sees the growth of its own buffers, so count what the assembly really allocates
+    ProblemWorkspace ws;
+    auto assemble = [&](){
+        assemble_A_matrix(ws, corridor, MQM, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity,
+                tgp.maxAcceleration, order, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration);
+    };
+    assemble();
+    long assembly_alloc = allocations(assemble);
+
+    ObjectiveMatrix objective(tgp.minimizeOrder, segment_num, order, room_time, MQM, "L");
+    ConstraintMatrix constraint(corridor, MQM, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity,
+            tgp.maxAcceleration, order, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration);
+    const LinearConstr &lincon = constraint.lincon;
+    VX q = VX::Zero(lincon.n_var);
+    long update_alloc = allocations([&](){constraint.update_times(room_time);});
+
+    QPSolver qp;
+    int qp_status = qp.solve(objective.P, q, constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+    QPSettings scaled_settings;
+    scaled_settings.scaling_iter = 1;  // more passes only slow ADMM down further
+    scaled_settings.max_iter = 50000;
+    QPSolver scaled(scaled_settings);
+    int scaled_status = scaled.solve(objective.P, q, constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+    BandedIPMSolver ipm(3 * (order + 1));
+    int ipm_status = ipm.solve(objective.P, q, constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+
+    // order 7 as well, whose mapping matrix had an entry of the wrong sign before the tables
+    Bernstein bz7(7, 7, tgp.minimizeOrder);
+    MatrixXd MQM7 = bz7.getMQM()[7];
+    ObjectiveMatrix objective7(tgp.minimizeOrder, segment_num, 7, room_time, MQM7, "L");
+    ConstraintMatrix constraint7(corridor, MQM7, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity,
+            tgp.maxAcceleration, 7, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration);
+    const LinearConstr &lincon7 = constraint7.lincon;
+    BandedIPMSolver ipm7(3 * 8);
+    int ipm7_status = ipm7.solve(objective7.P, VX::Zero(lincon7.n_var), constraint7.A, lincon7.clb, lincon7.cub,
+            lincon7.xlb, lincon7.xub);
+    double eval7_diff = ipm7_status == QP_SOLVED ? evaluator_diff(bz7.getM()[7], ipm7.x, room_time)
+        : std::numeric_limits<double>::quiet_NaN();
+
+    // the calls with a workspace at any point, the first one sizes the buffers
+    auto grad_A = [&](cRefVX x, cRefVX lmdy, cRefVX lmdz) -> VX {
+        return gradient_from_A(ws, corridor, MQM, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity,
+                tgp.maxAcceleration, order, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration,
+                x, lmdy, lmdz);
+    };
+    VX x0 = VX::Zero(lincon.n_var), ly0 = VX::Zero(lincon.n_con);
+    grad_A(x0, ly0, x0);
+    long grad_alloc = allocations([&](){
+        gradient_from_A(ws, corridor, MQM, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity,
+                tgp.maxAcceleration, order, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration,
+                x0, ly0, x0);
+    });
+    // sized as in ott_benchmark
+    int n_F = 1 + lincon.n_con + lincon.n_var + 1;
+    int n_G = (lincon.n_var + segment_num) + (lincon.n_nnz + 2 * lincon.n_con) + 2 * lincon.n_var + segment_num;
+    VX F(n_F), lb(n_F), ub(n_F), G(n_G);
+    lVX row(n_G), col(n_G);
+    auto snopt = [&](){
+        snopt_eval(ws, corridor, MQM, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity, tgp.maxAcceleration,
+                order, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration,
+                x0, F, lb, ub, G, row, col, true, true, true);
+    };
+    snopt();
+    long snopt_alloc = allocations(snopt);
+
+    // a copy that still holds the solution, without warm start it must run ADMM and fail to finish in one iteration
+    QPSolver capped = qp;
+    capped.settings.warm_start = false;
+    capped.settings.max_iter = 1;
+    capped.settings.polish = false;
+    int capped_status = capped.solve(objective.P, q, constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+    bool capped_ok = capped_status != QP_SOLVED && !capped.active_set_hit && std::isnan(capped.obj)
+        && capped.x.size() == (int)lincon.n_var && capped.x.array().isNaN().all() && capped.lmdy.array().isNaN().all();
+
+    printf("tgp_%d segments %d alloc %ld %ld %ld %ld binary %s slice %s order_7 eval_diff %.1e", index, segment_num,
+           assembly_alloc, update_alloc, grad_alloc, snopt_alloc, binary_ok ? "ok" : "differs", slice_ok ? "ok" : "differs",
+           eval7_diff);
+    bool alloc_ok = assembly_alloc == 0 && update_alloc == 0 && grad_alloc == 0 && snopt_alloc == 0;
+    bool baseline_ok = binary_ok && slice_ok && eval7_diff < EVAL_TOL;
+    if(qp_status != QP_SOLVED || ipm_status != QP_SOLVED || scaled_status != QP_SOLVED){
+        // all have to agree on infeasible problems too
+        bool ok = alloc_ok && baseline_ok && (qp_status == QP_SOLVED) == (ipm_status == QP_SOLVED)
+            && (scaled_status == QP_SOLVED) == (ipm_status == QP_SOLVED);
+        printf(" status qp %d scaled %d ipm %d %s\n", qp_status, scaled_status, ipm_status, ok ? "ok" : "FAILED");
+        return ok;
+    }
+
+    KKTResidual qp_kkt = kkt_residual(objective.P, constraint, qp.x, qp.lmdy, qp.lmdz);
+    KKTResidual scaled_kkt = kkt_residual(objective.P, constraint, scaled.x, scaled.lmdy, scaled.lmdz);
+    KKTResidual ipm_kkt = kkt_residual(objective.P, constraint, ipm.x, ipm.lmdy, ipm.lmdz);
+    double obj_diff = std::abs(qp.obj - ipm.obj) / std::max(1.0, std::abs(qp.obj));
+    double scaled_obj_diff = std::abs(scaled.obj - ipm.obj) / std::max(1.0, std::abs(scaled.obj));
+    double grad_diff = rel_diff(grad_A(qp.x, qp.lmdy, qp.lmdz), grad_A(ipm.x, ipm.lmdy, ipm.lmdz));
+    double eval_diff = evaluator_diff(bz.getM()[order], ipm.x, room_time);
+    TimeAllocator allocator(tgp, MQM);
+    double hess_diff = allocator.solve_once() ? hessian_diff(allocator) : std::numeric_limits<double>::quiet_NaN();
+
+    bool ok = alloc_ok && baseline_ok && capped_ok && qp_kkt.worst() < KKT_TOL && scaled_kkt.worst() < SCALED_KKT_TOL && ipm_kkt.worst() < KKT_TOL
+        && obj_diff < OBJ_TOL && scaled_obj_diff < OBJ_TOL && grad_diff < GRAD_TOL && hess_diff < HESS_TOL
+        && eval_diff < EVAL_TOL;
+    printf(" obj %.10g %.10g kkt qp %.1e %.1e %.1e ipm %.1e %.1e %.1e obj_diff %.1e grad_A_diff %.1e"
+           " scaled kkt %.1e obj_diff %.1e capped %s hess_diff %.1e eval_diff %.1e %s\n",
+           qp.obj, ipm.obj, qp_kkt.stationarity, qp_kkt.primal, qp_kkt.complementarity,
+           ipm_kkt.stationarity, ipm_kkt.primal, ipm_kkt.complementarity, obj_diff, grad_diff,
+           scaled_kkt.worst(), scaled_obj_diff, capped_ok ? "ok" : "stale", hess_diff, eval_diff, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+
+/* tgp_30 as given in its file (order 8 with velocity limits) is the one problem of the dataset solve_batch fails on with
+ * the file settings. It is feasible, but polishing only succeeds after about 18000 ADMM iterations, so QPSolver stops at
+ * QP_MAX_ITER_REACHED with the default max_iter. BandedIPMSolver solves it, and so does QPSolver given the iterations.
+ */
+static bool check_slow_admm(const std::string &dir){
+    std::string file = dir + "/tgp_30.tgp";
+    if(!file_exists(file))
+        return true;
+    TGProblem tgp;
+    loadTGProblemFromFile(file, tgp);
+    int order = tgp.trajectoryOrder;
+    Bernstein bz;
+    bz.setParam(order, order, tgp.minimizeOrder);
+    MatrixXd MQM = bz.getMQM()[order];
+    std::vector<pyBox> corridor;
+    for(auto &box : tgp.corridor)
+        corridor.push_back(pyBox(box));
+    int segment_num = corridor.size();
+    VX room_time(segment_num);
+    for(int i = 0; i < segment_num; i++)
+        room_time(i) = corridor[i].t;
+
+    ObjectiveMatrix objective(tgp.minimizeOrder, segment_num, order, room_time, MQM, "L");
+    ConstraintMatrix constraint(corridor, MQM, tgp.position, tgp.velocity, tgp.acceleration, tgp.maxVelocity,
+            tgp.maxAcceleration, order, tgp.minimizeOrder, tgp.margin, tgp.doLimitVelocity, tgp.doLimitAcceleration);
+    const LinearConstr &lincon = constraint.lincon;
+    VX q = VX::Zero(lincon.n_var);
+    QPSolver qp;
+    int qp_status = qp.solve(objective.P, q, constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+    QPSettings long_settings;
+    long_settings.max_iter = 30000;
+    QPSolver long_qp(long_settings);
+    int long_status = long_qp.solve(objective.P, q, constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+    BandedIPMSolver ipm(3 * (order + 1));
+    int ipm_status = ipm.solve(objective.P, q, constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+
+    double obj_diff = std::abs(long_qp.obj - ipm.obj) / std::max(1.0, std::abs(ipm.obj));
+    bool ok = qp_status == QP_MAX_ITER_REACHED && long_status == QP_SOLVED && ipm_status == QP_SOLVED && obj_diff < OBJ_TOL;
+    printf("tgp_30 file settings status qp %d, %d after %d iterations, ipm %d obj %.10g %.10g %s\n", qp_status,
+           long_status, long_qp.iter, ipm_status, long_qp.obj, ipm.obj, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+
+int main(int argc, char **argv){
+    std::string dir = argc > 1 ? argv[1] : "dataset";
+    int stride = argc > 2 ? std::max(1, atoi(argv[2])) : 20;
+
+    int n_problem = 0, n_failed = 0;
+    for(int i = 0; ; i += stride){
+        std::string file = dir + "/tgp_" + std::to_string(i) + ".tgp";
+        if(!file_exists(file))
+            break;
+        n_problem++;
+        if(!check_problem(file, i))
+            n_failed++;
+    }
+    if(n_problem == 0){
+        cout << "[Error]No problem found in " << dir << endl;
+        return 1;
+    }
+    n_problem += 2;
+    if(!check_bernstein())
+        n_failed++;
+    if(!check_slow_admm(dir))
+        n_failed++;
+    printf("%d of %d checks failed\n", n_failed, n_problem);
+    return n_failed > 0 ? 1 : 0;
+}
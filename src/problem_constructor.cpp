@@ -9,12 +9,15 @@
 #include <tuple>
 #include <limits>
 
-#include "ott/pybind_box_type.h"
+#include "ott/problem_constructor.h"
+#include "ott/order_kernels.h"
+#include "ott/trace_recorder.h"
 
 typedef int MSKint32t;
 
 
-int PRINTLEVEL = 0;
+// each thread has its own print level so problems can be solved concurrently
+thread_local int PRINTLEVEL = 0;
 
 double LMD_TOL = 1e-4;
 
@@ -22,12 +25,15 @@ void set_print_level(int level){
     PRINTLEVEL = level;
 }
 
+int get_print_level(){
+    return PRINTLEVEL;
+}
+
 // Generate the P matrix for the problem
 // type = "l" if lower triangular is wanted; "u" is upper is desired; "f" is full matrix is desired
 std::tuple<VX, lVX, lVX> construct_P_matrix(double minimize_order, int segment_num, int poly_order, RefVX room_time, RefMX MQM, std::string &type){
-    int min_order_l = floor(minimize_order);
-    int min_order_u = ceil (minimize_order);
-
+    TraceSpan span("construct_P");
+    span.arg("segments", segment_num);
     int NUMQNZ = 0;
     int NUMQ_blk = (poly_order + 1);                       // default minimize the jerk and minimize_order = 3
     if(type == "f" || type == "F")
@@ -38,63 +44,15 @@ std::tuple<VX, lVX, lVX> construct_P_matrix(double minimize_order, int segment_n
     VX qval = VX::Zero(NUMQNZ);
     lVX qsubi = lVX::Zero(NUMQNZ);
     lVX qsubj = lVX::Zero(NUMQNZ);
-
-    int sub_shift = 0;
-    int idx = 0;
-    int s1d1CtrlP_num = poly_order + 1;
-    int s1CtrlP_num = 3 * s1d1CtrlP_num;
-    for (int k = 0; k < segment_num; k++)
-    {
-        double scale_k = room_time(k);
-        for (int p = 0; p < 3; p ++ )
-            for ( int i = 0; i < s1d1CtrlP_num; i ++ )
-                for ( int j = 0; j < s1d1CtrlP_num; j ++ ){
-                    if(((type == "l" || type == "L") && i >= j) || ((type == "u" || type == "U") && i <= j) || (type == "f" || type == "F")) {
-                        qsubi(idx) = sub_shift + p * s1d1CtrlP_num + i;
-                        qsubj(idx) = sub_shift + p * s1d1CtrlP_num + j;
-                        //qval[idx]  = MQM(i, j) /(double)pow(scale_k, 3);
-                        if (min_order_l == min_order_u)
-                            qval(idx)  = MQM(i, j) / (double)pow(scale_k, 2 * min_order_u - 3);
-                        else
-                            qval(idx) = ( (minimize_order - min_order_l) / (double)pow(scale_k, 2 * min_order_u - 3)
-                                          + (min_order_u - minimize_order) / (double)pow(scale_k, 2 * min_order_l - 3) ) * MQM(i, j);
-                        idx ++ ;
-                    }
-                }
-
-        sub_shift += s1CtrlP_num;
-    }
+    char tp = type.empty() ? ' ' : type[0];
+    order_kernels(poly_order).fill_P(NUMQ_blk, room_time.head(segment_num), minimize_order, MQM, tp, qval, qsubi, qsubj);
     return std::make_tuple(qval, qsubi, qsubj);
 }
 
-VX gradient_from_P(double minimize_order, int segment_num, int poly_order, RefVX room_time, RefMX MQM, RefVX sol){
-    int min_order_l = floor(minimize_order);
-    int min_order_u = ceil (minimize_order);
-
+VX gradient_from_P(double minimize_order, int segment_num, int poly_order, cRefVX room_time, cRefMX MQM, cRefVX sol){
+    TraceSpan span("gradient_from_P");
     VX pgrad = VX::Zero(segment_num);  // record the results
-
-    int s1d1CtrlP_num = poly_order + 1;
-    int s1CtrlP_num = 3 * s1d1CtrlP_num;
-    MatrixXd subH(s1CtrlP_num, s1CtrlP_num);
-    for (int k = 0; k < segment_num; k++) {
-        subH.setZero();
-        double scale_k = room_time(k);
-        RefVX x = sol.segment(k * s1CtrlP_num, s1CtrlP_num);
-        for (int p = 0; p < 3; p++ ){
-            for ( int i = 0; i < s1d1CtrlP_num; i ++ ){
-                for ( int j = 0; j < s1d1CtrlP_num; j ++ ){
-                    double deriv = 0;
-                    if (min_order_l == min_order_u)
-                        deriv = MQM(i, j) * (3 - 2 * min_order_u) * (double)pow(scale_k, 2 - 2 * min_order_u);
-                    else
-                        deriv = ((minimize_order - min_order_l) * (double)pow(scale_k, 2 - 2 * min_order_u) * (3 - 2 * min_order_u)
-                                 + (min_order_u - minimize_order) * (3 - 2 * min_order_l) * (double)pow(scale_k, 2 - 2 * min_order_l)) * MQM(i, j);
-                    subH(p * s1d1CtrlP_num + i, p * s1d1CtrlP_num + j) = deriv;
-                }
-            }
-        }
-        pgrad(k) = 0.5 * x.dot(subH * x);
-    }
+    order_kernels(poly_order).gradient_from_P(poly_order + 1, room_time.head(segment_num), minimize_order, MQM, sol, pgrad);
     return pgrad;
 }
 
@@ -113,8 +71,31 @@ LinearConstr construct_A_matrix(
             const bool & isLimitVel,
             const bool & isLimitAcc
         ){
-    ConstraintTape var_tape;  // records bounds on variables
-    ConstraintTape con_tape;  // records bounds on constraints
+    ProblemWorkspace ws;
+    return assemble_A_matrix(ws, corridor, MQM, pos, vel, acc, maxVel, maxAcc, traj_order, minimize_order, margin, isLimitVel, isLimitAcc);
+}
+
+
+const LinearConstr &assemble_A_matrix(
+            ProblemWorkspace &ws,
+            const vector<pyBox> &corridor,
+            const MatrixXd &MQM,
+            const MatrixXd &pos,
+            const MatrixXd &vel,
+            const MatrixXd &acc,
+            const double maxVel,
+            const double maxAcc,
+            const int traj_order,
+            const double minimize_order,
+            const double margin,
+            const bool & isLimitVel,
+            const bool & isLimitAcc
+        ){
+    TraceSpan span("construct_A");
+    span.arg("segments", corridor.size());
+    ws.prepare(corridor.size(), traj_order, isLimitVel, isLimitAcc);
+    ConstraintTape &var_tape = ws.var_tape;  // records bounds on variables
+    ConstraintTape &con_tape = ws.con_tape;  // records bounds on constraints
 
     double initScale = corridor.front().t;
     double lstScale  = corridor.back().t;
@@ -124,19 +105,10 @@ LinearConstr construct_A_matrix(
     int s1d1CtrlP_num = n_poly;
     int s1CtrlP_num   = 3 * s1d1CtrlP_num;
 
-    int equ_con_s_num = 3 * 3; // p, v, a in x, y, z axis at the start point
-    int equ_con_e_num = 3 * 3; // p, v, a in x, y, z axis at the end point
-    int equ_con_continuity_num = 3 * 3 * (segment_num - 1);
-    int equ_con_num   = equ_con_s_num + equ_con_e_num + equ_con_continuity_num; // p, v, a in x, y, z axis in each segment's joint position
-
-    int vel_con_num = 3 *  traj_order * segment_num;
-    int acc_con_num = 3 * (traj_order - 1) * segment_num;
-
-    if ( !isLimitVel )
-        vel_con_num = 0;
-
-    if ( !isLimitAcc)
-        acc_con_num = 0;
+    const ProblemSize &sz = ws.size();
+    int equ_con_num = sz.equ_con_num; // p, v, a in x, y, z axis at start, end and each segment's joint position
+    int vel_con_num = sz.vel_con_num;
+    int acc_con_num = sz.acc_con_num;
 
 
     //int high_order_con_num = vel_con_num + acc_con_num;
@@ -182,7 +154,7 @@ LinearConstr construct_A_matrix(
 
     for (int k = 0; k < segment_num; k++)
     {
-        pyBox cube_     = corridor[k];
+        const pyBox &cube_ = corridor[k];
         double scale_k = cube_.t;
 
         for (int i = 0; i < 3; i++ )
@@ -432,8 +404,8 @@ LinearConstr construct_A_matrix(
             sub_shift += s1CtrlP_num;
         }
     }
-    LinearConstr lincon(con_tape, var_tape);
-    return lincon;
+    ws.finish();
+    return ws.lincon;
 }
 
 
@@ -450,43 +422,55 @@ VX gradient_from_A(
             const double margin,
             const bool & isLimitVel,
             const bool & isLimitAcc,
-            RefVX sol,
-            RefVX lmdy,  //lmdy is for constraints
-            RefVX lmdz  // lmdz is for bounds on variables
+            cRefVX sol,
+            cRefVX lmdy,  //lmdy is for constraints
+            cRefVX lmdz  // lmdz is for bounds on variables
+        ){
+    ProblemWorkspace ws;
+    return gradient_from_A(ws, corridor, MQM, pos, vel, acc, maxVel, maxAcc, traj_order, minimize_order, margin, isLimitVel, isLimitAcc, sol, lmdy, lmdz);
+}
+
+
+const VX &gradient_from_A(
+            ProblemWorkspace &ws,
+            const vector<pyBox> &corridor,
+            const MatrixXd &MQM,
+            const MatrixXd &pos,
+            const MatrixXd &vel,
+            const MatrixXd &acc,
+            const double maxVel,
+            const double maxAcc,
+            const int traj_order,
+            const double minimize_order,
+            const double margin,
+            const bool & isLimitVel,
+            const bool & isLimitAcc,
+            cRefVX sol,
+            cRefVX lmdy,
+            cRefVX lmdz
         ){
+    TraceSpan span("gradient_from_A");
     double initScale = corridor.front().t;
     double lstScale  = corridor.back().t;
     int segment_num  = corridor.size();
 
-    VX agrad = VX::Zero(segment_num);  // store gradient here
+    ws.prepare(segment_num, traj_order, isLimitVel, isLimitAcc);
+    VX &agrad = ws.grad;  // store gradient here
+    agrad.setZero();
 
     int n_poly = traj_order + 1;
     int s1d1CtrlP_num = n_poly;
     int s1CtrlP_num   = 3 * s1d1CtrlP_num;
 
-    // int equ_con_s_num = 3 * 3; // p, v, a in x, y, z axis at the start point
-    // int equ_con_e_num = 3 * 3; // p, v, a in x, y, z axis at the end point
-    // int equ_con_continuity_num = 3 * 3 * (segment_num - 1);
-    // int equ_con_num   = equ_con_s_num + equ_con_e_num + equ_con_continuity_num; // p, v, a in x, y, z axis in each segment's joint position
-
-    int vel_con_num = 3 *  traj_order * segment_num;
-    int acc_con_num = 3 * (traj_order - 1) * segment_num;
-
     int ctrlP_num = segment_num * s1CtrlP_num;
 
-    if ( !isLimitVel )
-        vel_con_num = 0;
-
-    if ( !isLimitAcc)
-        acc_con_num = 0;
-
     /* ## define a container for control points' boundary and boundkey ## */
     /* ## dataType in one tuple is : boundary type, lower bound, upper bound ## */
 
     int var_idx = 0;
     for (int k = 0; k < segment_num; k++)
     {
-        pyBox cube_     = corridor[k];
+        const pyBox &cube_ = corridor[k];
         double scale_k = cube_.t;
 
         for (int i = 0; i < 3; i++ )
@@ -521,20 +505,8 @@ VX gradient_from_A(
 
 
     int row_idx = 0;
-    // The velocity constraints
-    if (isLimitVel)  // there is nothing we should do
-    {
-        for (int k = 0; k < segment_num ; k ++ )
-        {
-            for (int i = 0; i < 3; i++)
-            {   // for x, y, z loop
-                for (int p = 0; p < traj_order; p++)
-                {
-                    row_idx ++;
-                }
-            }
-        }
-    }
+    // The velocity constraints, there is nothing we should do
+    row_idx += ws.size().vel_con_num;
 
 
     // The acceleration constraints
@@ -786,53 +758,7 @@ int assign_G(RefVX G, ReflVX row, ReflVX col, int row_idx, int nG, int nz, doubl
 
 
 double cost_eval_with_grad(cRefVX coef, cRefVX room_time, int traj_order, double minimize_order, cRefMX MQM, RefVX G, bool needg){
-    int segment_num = room_time.size();
-    int n_poly = traj_order + 1;
-    int s1d1CtrlP_num = n_poly;
-    int s1CtrlP_num   = 3 * s1d1CtrlP_num;
-    int n_coef = s1CtrlP_num * segment_num;  // number of coefficients
-
-    int min_order_l = floor(minimize_order);
-    int min_order_u = ceil (minimize_order);
-
-    int sub_shift = 0;
-    double cost = 0;  // record total cost
-    for (int k = 0; k < segment_num; k++)
-    {
-        double scale_k = room_time(k);
-        double djdt = 0;
-        for (int p = 0; p < 3; p ++ ){
-            for ( int i = 0; i < s1d1CtrlP_num; i ++ ){
-                int row_id = sub_shift + p * s1d1CtrlP_num + i;
-                if(needg)
-                    G(row_id) = 0;
-                for ( int j = 0; j < s1d1CtrlP_num; j ++ ){
-                    int col_id = sub_shift + p * s1d1CtrlP_num + j;
-                    double val = 0;
-                    double dvdt = 0;
-                    //qval[idx]  = MQM(i, j) /(double)pow(scale_k, 3);
-                    if (min_order_l == min_order_u){
-                        val  = MQM(i, j) / (double)pow(scale_k, 2 * min_order_u - 3);
-                        dvdt = MQM(i, j) * (double)pow(scale_k, 2 - 2 * min_order_u) * (3 - 2 * min_order_u);
-                    }
-                    else{
-                        val = ( (minimize_order - min_order_l) / (double)pow(scale_k, 2 * min_order_u - 3)
-                                      + (min_order_u - minimize_order) / (double)pow(scale_k, 2 * min_order_l - 3) ) * MQM(i, j);
-                        dvdt = ( (minimize_order - min_order_l) / (double)pow(scale_k, 2 * min_order_u - 2) * (3 - 2 * min_order_u)
-                                      + (min_order_u - minimize_order) / (double)pow(scale_k, 2 * min_order_l - 2) * (3 - 2 * min_order_l) ) * MQM(i, j);
-                    }
-                    cost += 0.5 * coef(row_id) * val * coef(col_id);
-                    djdt += 0.5 * coef(row_id) * dvdt * coef(col_id);
-                    if(needg)
-                        G(row_id) += val * coef(col_id);
-                }
-            }
-        }
-        if(needg)
-            G(n_coef + k) = djdt;
-        sub_shift += s1CtrlP_num;
-    }
-    return cost;
+    return order_kernels(traj_order).cost_with_grad(traj_order + 1, coef, room_time, minimize_order, MQM, G, needg);
 }
 
 // evaluate cost function using this code
@@ -869,12 +795,43 @@ std::pair<int, int> snopt_eval(
             bool rec,
             bool needlub
         ){
+    ProblemWorkspace ws;
+    return snopt_eval(ws, corridor, MQM, pos, vel, acc, maxVel, maxAcc, traj_order, minimize_order, margin, isLimitVel, isLimitAcc, coef, F, lb, ub, G, row, col, needg, rec, needlub);
+}
+
+
+std::pair<int, int> snopt_eval(
+            ProblemWorkspace &ws,
+            const vector<pyBox> &corridor,
+            const MatrixXd &MQM,
+            const MatrixXd &pos,
+            const MatrixXd &vel,
+            const MatrixXd &acc,
+            const double maxVel,
+            const double maxAcc,
+            const int traj_order,
+            const double minimize_order,
+            const double margin,
+            const bool & isLimitVel,
+            const bool & isLimitAcc,
+            cRefVX coef,
+            RefVX F,
+            RefVX lb,
+            RefVX ub,
+            RefVX G,
+            ReflVX row,
+            ReflVX col,
+            bool needg,
+            bool rec,
+            bool needlub
+        ){
     int nG = 0;
 
     double initScale = corridor.front().t;
     double lstScale  = corridor.back().t;
     int segment_num  = corridor.size();
-    VX room_time(segment_num);
+    ws.prepare(segment_num, traj_order, isLimitVel, isLimitAcc);
+    VX &room_time = ws.times;
     for(int i = 0; i < segment_num; i++)
         room_time(i) = corridor[i].t;
     int ncoef = coef.size();
@@ -885,20 +842,6 @@ std::pair<int, int> snopt_eval(
     int s1d1CtrlP_num = n_poly;
     int s1CtrlP_num   = 3 * s1d1CtrlP_num;
 
-    int equ_con_s_num = 3 * 3; // p, v, a in x, y, z axis at the start point
-    int equ_con_e_num = 3 * 3; // p, v, a in x, y, z axis at the end point
-    int equ_con_continuity_num = 3 * 3 * (segment_num - 1);
-    int equ_con_num   = equ_con_s_num + equ_con_e_num + equ_con_continuity_num; // p, v, a in x, y, z axis in each segment's joint position
-
-    int vel_con_num = 3 *  traj_order * segment_num;
-    int acc_con_num = 3 * (traj_order - 1) * segment_num;
-
-    if ( !isLimitVel )
-        vel_con_num = 0;
-
-    if ( !isLimitAcc)
-        acc_con_num = 0;
-
 
     //int high_order_con_num = vel_con_num + acc_con_num;
     //int high_order_con_num = 0; //3 * traj_order * segment_num;
@@ -1385,7 +1328,7 @@ std::pair<int, int> snopt_eval(
     int var_idx = 0;
     for (int k = 0; k < segment_num; k++)
     {
-        pyBox cube_     = corridor[k];
+        const pyBox &cube_ = corridor[k];
         double scale_k = cube_.t;
 
         for (int i = 0; i < 3; i++ )
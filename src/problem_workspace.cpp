@@ -0,0 +1,70 @@
+/*
+ * problem_workspace.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include "ott/problem_workspace.h"
+
+
+ProblemSize::ProblemSize(int segment_num_, int traj_order_, bool limit_vel_, bool limit_acc_):
+    segment_num(segment_num_),
+    traj_order(traj_order_),
+    limit_vel(limit_vel_),
+    limit_acc(limit_acc_)
+{
+    int s1CtrlP_num = 3 * (traj_order + 1);
+    n_var = segment_num * s1CtrlP_num;
+
+    int equ_con_s_num = 3 * 3; // p, v, a in x, y, z axis at the start point
+    int equ_con_e_num = 3 * 3; // p, v, a in x, y, z axis at the end point
+    int equ_con_continuity_num = 3 * 3 * (segment_num - 1);
+    equ_con_num = equ_con_s_num + equ_con_e_num + equ_con_continuity_num;
+
+    vel_con_num = limit_vel ? 3 * traj_order * segment_num : 0;
+    acc_con_num = limit_acc ? 3 * (traj_order - 1) * segment_num : 0;
+    n_con = vel_con_num + acc_con_num + equ_con_num;
+
+    // start and end use 1, 2, 3 nonzeros for p, v, a; a joint uses 2, 4, 6
+    n_nnz = 2 * vel_con_num + 3 * acc_con_num + 2 * 3 * (1 + 2 + 3) + (segment_num - 1) * 3 * (2 + 4 + 6);
+}
+
+
+void ProblemWorkspace::prepare(int segment_num, int traj_order, bool isLimitVel, bool isLimitAcc){
+    con_tape.clear();
+    var_tape.clear();
+    ProblemSize new_shape(segment_num, traj_order, isLimitVel, isLimitAcc);
+    if(new_shape.same_shape(shape))
+        return;
+    shape = new_shape;
+    if(grad.size() != segment_num){
+        grad.resize(segment_num);
+        times.resize(segment_num);
+        num_alloc++;
+    }
+    if((size_t)shape.n_con > capacity_con || (size_t)shape.n_nnz > capacity_nnz || (size_t)shape.n_var > capacity_var){
+        con_tape.reserve(shape.n_con, shape.n_nnz);
+        var_tape.reserve(shape.n_var, 0);
+        capacity_con = con_tape.lb.capacity();
+        capacity_nnz = con_tape.val.capacity();
+        capacity_var = var_tape.lb.capacity();
+        num_alloc++;
+    }
+}
+
+
+void ProblemWorkspace::finish(){
+    // Eigen reallocates whenever a size changes
+    if(lincon.values.size() != (int)con_tape.val.size() || lincon.clb.size() != (int)con_tape.lb.size()
+            || lincon.xlb.size() != (int)var_tape.lb.size())
+        num_alloc++;
+    lincon.assign(con_tape, var_tape);
+    // the tapes grew past what we reserved, which means the counts in ProblemSize are off
+    if(con_tape.lb.capacity() != capacity_con || con_tape.val.capacity() != capacity_nnz || var_tape.lb.capacity() != capacity_var){
+        capacity_con = con_tape.lb.capacity();
+        capacity_nnz = con_tape.val.capacity();
+        capacity_var = var_tape.lb.capacity();
+        num_alloc++;
+    }
+}
@@ -10,95 +10,59 @@
 #include "pybind11/pybind11.h"
 #include "pybind11/stl.h"
 #include "pybind11/chrono.h"
+#include "pybind11/numpy.h"
 #include "time.h"
 #include "stdlib.h"
+#include <stdexcept>
 #include "ott/data_types.h"
 #include "ott/pybind_box_type.h"
 #include "ott/TGProblem.h"
+#include "ott/tgp_binary.h"
+#include "ott/qp_solver.h"
+#include "ott/problem_constructor.h"
+#include "ott/problem_workspace.h"
+#include "ott/constraint_matrix.h"
+#include "ott/objective_matrix.h"
+#include "ott/banded_ipm.h"
+#include "ott/planner_stats.h"
+#include "ott/trace_recorder.h"
+#include "ott/time_allocator.h"
+#include "ott/batch_planner.h"
+#include "ott/receding_horizon.h"
+#include "ott/trajectory_evaluator.h"
 
 
 namespace py = pybind11;
 using namespace pybind11::literals;
 
 
+// a binary file that cannot be read falls back to the text archive of the same name, e.g. tgp_0.tgp for tgp_0.tgpb
 pyTGProblem loadTGP(const std::string fileName){
     TGProblem prob;
-    loadTGProblemFromFile(fileName, prob);
+    if(!isTGProblemBinary(fileName))
+        loadTGProblemFromFile(fileName, prob);
+    else if(!loadTGProblemFromBinary(fileName, prob)){
+        std::string textName = fileName;
+        if(textName.size() > 5 && textName.compare(textName.size() - 5, 5, ".tgpb") == 0)
+            textName.pop_back();
+        if(textName == fileName || !std::ifstream(textName).good())
+            throw std::runtime_error("cannot load " + fileName + " and there is no text archive to fall back to");
+        cout << "[INFO] Loading " << textName << " instead of " << fileName << endl;
+        loadTGProblemFromFile(textName, prob);
+    }
     pyTGProblem problem(prob);
     return problem;
 }
 
+bool saveTGPBinary(const pyTGProblem &p, const std::string fileName){
+    return saveTGProblemToBinary(p, fileName);
+}
+
 void printTGP(const pyTGProblem& p){
     printTGProblem(p);
 }
 
 
-void set_print_level(int level);
-// subroutines for problem construction
-std::tuple<VX, lVX, lVX> construct_P_matrix(double minimize_order, int segment_num, int poly_order, RefVX room_time, RefMX MQM, std::string &type);
-
-VX gradient_from_P(double minimize_order, int segment_num, int poly_order, RefVX room_time, RefMX MQM, RefVX sol);
-
-LinearConstr construct_A_matrix(
-    const vector<pyBox> &corridor,
-    const MatrixXd &MQM,
-    const MatrixXd &pos,
-    const MatrixXd &vel,
-    const MatrixXd &acc,
-    const double maxVel,
-    const double maxAcc,
-    const int traj_order,
-    const double minimize_order,
-    const double margin,
-    const bool & isLimitVel,
-    const bool & isLimitAcc);
-
-VX gradient_from_A(
-            const vector<pyBox> &corridor,
-            const MatrixXd &MQM,
-            const MatrixXd &pos,
-            const MatrixXd &vel,
-            const MatrixXd &acc,
-            const double maxVel,
-            const double maxAcc,
-            const int traj_order,
-            const double minimize_order,
-            const double margin,
-            const bool & isLimitVel,
-            const bool & isLimitAcc,
-            RefVX sol,
-            RefVX lmdy,  //lmdy is for constraints
-            RefVX lmdz  // lmdz is for bounds on variables
-        );
-
-
-std::pair<int, int> snopt_eval(
-            const vector<pyBox> &corridor,
-            const MatrixXd &MQM,
-            const MatrixXd &pos,
-            const MatrixXd &vel,
-            const MatrixXd &acc,
-            const double maxVel,
-            const double maxAcc,
-            const int traj_order,
-            const double minimize_order,
-            const double margin,
-            const bool & isLimitVel,
-            const bool & isLimitAcc,
-            cRefVX coef,  // the coefficients
-            RefVX F,  // records actual function values
-            RefVX lb,  // records lower bound since previous one does not apply
-            RefVX ub,  // records upper bound since previous one does not apply
-            RefVX G,  // record gradients, treat all things nonlinear
-            ReflVX row,  // record rows of gradients
-            ReflVX col,  // record cols of gradients
-            bool needg,  // enable recording of G
-            bool rec,
-            bool needlub  // enable recording of lb and ub
-        );
-std::pair<double, VX> eval_f(cRefVX coef, cRefVX room_time, int traj_order, double minimize_order, cRefMX MQM, bool needg);
-
-
 PYBIND11_MODULE(libott, m){
     py::class_<pyBox>(m, "PyBox")
         .def(py::init<>())
@@ -147,16 +111,333 @@ PYBIND11_MODULE(libott, m){
         .def_readwrite("xub", &LinearConstr::xub)
         .def_readwrite("clb", &LinearConstr::clb)
         .def_readwrite("cub", &LinearConstr::cub)
-        .def_readwrite("aval", &LinearConstr::aval)
-        .def_readwrite("arow", &LinearConstr::arow)
-        .def_readwrite("acol", &LinearConstr::acol)
+        .def_readwrite("values", &LinearConstr::values)
+        .def_readwrite("rowind", &LinearConstr::rowind)
+        .def_readwrite("colptr", &LinearConstr::colptr)
         .def_readwrite("n_var", &LinearConstr::n_var)
         .def_readwrite("n_con", &LinearConstr::n_con)
         .def_readwrite("n_nnz", &LinearConstr::n_nnz)
         ;
 
-    m.def("loadTGP", &loadTGP);
+    py::class_<ProblemWorkspace>(m, "ProblemWorkspace")
+        .def(py::init<>())
+        // the buffers themselves, see assemble_A
+        .def_readonly("lincon", &ProblemWorkspace::lincon)
+        .def_readonly("num_alloc", &ProblemWorkspace::num_alloc)
+        ;
+
+    py::class_<ConstraintMatrix>(m, "ConstraintMatrix")
+        .def(py::init<const vector<pyBox>&, const MatrixXd&, const MatrixXd&, const MatrixXd&, const MatrixXd&,
+                double, double, int, double, double, const bool&, const bool&>())  // same arguments as construct_A
+        .def("update_times", &ConstraintMatrix::update_times)
+        .def("num_segment", &ConstraintMatrix::num_segment)
+        .def_readonly("lincon", &ConstraintMatrix::lincon)
+        ;
+
+    py::class_<ObjectiveMatrix>(m, "ObjectiveMatrix")
+        .def(py::init<double, int, int, cRefVX, cRefMX, const std::string&>(),
+                "minimize_order"_a, "segment_num"_a, "poly_order"_a, "room_time"_a, "MQM"_a, "type"_a = "L")
+        .def("update_times", &ObjectiveMatrix::update_times)
+        .def("num_segment", &ObjectiveMatrix::num_segment)
+        .def_static("segment_scale", &ObjectiveMatrix::segment_scale)
+        // data is a view on the values, so scipy.sparse.csc_matrix((data, indices, indptr)) sees every update_times
+        .def_property_readonly("data", [](ObjectiveMatrix &obj){
+                    return Eigen::Map<VX>(obj.P.valuePtr(), obj.P.nonZeros());
+                }, py::return_value_policy::reference_internal)
+        .def_property_readonly("indices", [](ObjectiveMatrix &obj){
+                    return Eigen::VectorXi(Eigen::Map<Eigen::VectorXi>(obj.P.innerIndexPtr(), obj.P.nonZeros()));
+                })
+        .def_property_readonly("indptr", [](ObjectiveMatrix &obj){
+                    return Eigen::VectorXi(Eigen::Map<Eigen::VectorXi>(obj.P.outerIndexPtr(), obj.P.outerSize() + 1));
+                })
+        .def_property_readonly("shape", [](ObjectiveMatrix &obj){
+                    return std::make_pair(obj.P.rows(), obj.P.cols());
+                })
+        ;
+
+    py::class_<QPSettings>(m, "QPSettings")
+        .def(py::init<>())
+        .def_readwrite("rho", &QPSettings::rho)
+        .def_readwrite("sigma", &QPSettings::sigma)
+        .def_readwrite("alpha", &QPSettings::alpha)
+        .def_readwrite("eps_abs", &QPSettings::eps_abs)
+        .def_readwrite("eps_rel", &QPSettings::eps_rel)
+        .def_readwrite("eps_prim_inf", &QPSettings::eps_prim_inf)
+        .def_readwrite("max_iter", &QPSettings::max_iter)
+        .def_readwrite("check_interval", &QPSettings::check_interval)
+        .def_readwrite("scaling_iter", &QPSettings::scaling_iter)
+        .def_readwrite("adaptive_rho", &QPSettings::adaptive_rho)
+        .def_readwrite("adaptive_rho_tolerance", &QPSettings::adaptive_rho_tolerance)
+        .def_readwrite("adaptive_rho_interval", &QPSettings::adaptive_rho_interval)
+        .def_readwrite("polish", &QPSettings::polish)
+        .def_readwrite("polish_interval", &QPSettings::polish_interval)
+        .def_readwrite("polish_delta", &QPSettings::polish_delta)
+        .def_readwrite("polish_refine_iter", &QPSettings::polish_refine_iter)
+        .def_readwrite("warm_start", &QPSettings::warm_start)
+        .def_readwrite("active_set_fast_path", &QPSettings::active_set_fast_path)
+        .def_readwrite("active_set_updates", &QPSettings::active_set_updates)
+        ;
+
+    py::class_<QPSolver>(m, "QPSolver")
+        .def(py::init<>())
+        .def(py::init<QPSettings>())
+        .def("solve", &QPSolver::solve_triplets)  // (pval, prow, pcol, lincon) from construct_P and construct_A
+        .def("reset", &QPSolver::reset)
+        .def("set_warm_start", &QPSolver::set_warm_start)
+        .def("is_solved", &QPSolver::is_solved)
+        .def_readwrite("settings", &QPSolver::settings)
+        .def_readonly("x", &QPSolver::x)
+        .def_readonly("lmdy", &QPSolver::lmdy)
+        .def_readonly("lmdz", &QPSolver::lmdz)
+        .def_readonly("obj", &QPSolver::obj)
+        .def_readonly("status", &QPSolver::status)
+        .def_readonly("iter", &QPSolver::iter)
+        .def_readonly("polished", &QPSolver::polished)
+        .def_readonly("active_set_hit", &QPSolver::active_set_hit)
+        .def_readonly("active_set_hits", &QPSolver::active_set_hits)
+        .def_readonly("active_set_misses", &QPSolver::active_set_misses)
+        .def_readonly("warm_start_accepts", &QPSolver::warm_start_accepts)
+        .def_readonly("prim_res", &QPSolver::prim_res)
+        .def_readonly("dual_res", &QPSolver::dual_res)
+        .def_property_readonly("analyze_count", &QPSolver::analyze_count)
+        .def_property_readonly("factorize_count", &QPSolver::factorize_count)
+        ;
+
+    m.attr("QP_SOLVED") = (int)QP_SOLVED;
+    m.attr("QP_UNSOLVED") = (int)QP_UNSOLVED;
+    m.attr("QP_MAX_ITER_REACHED") = (int)QP_MAX_ITER_REACHED;
+    m.attr("QP_PRIMAL_INFEASIBLE") = (int)QP_PRIMAL_INFEASIBLE;
+    m.attr("QP_NON_CVX") = (int)QP_NON_CVX;
+    m.attr("QP_INVALID_DATA") = (int)QP_INVALID_DATA;
+
+    py::class_<IPMSettings>(m, "IPMSettings")
+        .def(py::init<>())
+        .def_readwrite("eps_abs", &IPMSettings::eps_abs)
+        .def_readwrite("eps_rel", &IPMSettings::eps_rel)
+        .def_readwrite("max_iter", &IPMSettings::max_iter)
+        .def_readwrite("step_ratio", &IPMSettings::step_ratio)
+        .def_readwrite("reg", &IPMSettings::reg)
+        .def_readwrite("refine_iter", &IPMSettings::refine_iter)
+        ;
+
+    py::class_<BandedIPMSolver>(m, "BandedIPMSolver")
+        .def(py::init<int, const IPMSettings&>(), "seg_size"_a, "settings"_a = IPMSettings())  // seg_size = 3 * (traj_order + 1)
+        .def("solve", &BandedIPMSolver::solve_triplets)  // (pval, prow, pcol, lincon) from construct_P and construct_A
+        .def("is_solved", &BandedIPMSolver::is_solved)
+        .def_readwrite("settings", &BandedIPMSolver::settings)
+        .def_readonly("x", &BandedIPMSolver::x)
+        .def_readonly("lmdy", &BandedIPMSolver::lmdy)
+        .def_readonly("lmdz", &BandedIPMSolver::lmdz)
+        .def_readonly("obj", &BandedIPMSolver::obj)
+        .def_readonly("status", &BandedIPMSolver::status)
+        .def_readonly("iter", &BandedIPMSolver::iter)
+        .def_readonly("prim_res", &BandedIPMSolver::prim_res)
+        .def_readonly("dual_res", &BandedIPMSolver::dual_res)
+        .def_readonly("gap", &BandedIPMSolver::gap)
+        ;
+
+    py::class_<TimeAllocatorSettings>(m, "TimeAllocatorSettings")
+        .def(py::init<>())
+        .def_readwrite("alpha0", &TimeAllocatorSettings::alpha0)
+        .def_readwrite("c", &TimeAllocatorSettings::c)
+        .def_readwrite("tau", &TimeAllocatorSettings::tau)
+        .def_readwrite("max_iter", &TimeAllocatorSettings::max_iter)
+        .def_readwrite("j_iter", &TimeAllocatorSettings::j_iter)
+        .def_readwrite("adaptive_line_search", &TimeAllocatorSettings::adaptive_line_search)
+        .def_readwrite("abs_obj_tol", &TimeAllocatorSettings::abs_obj_tol)
+        .def_readwrite("rel_obj_tol", &TimeAllocatorSettings::rel_obj_tol)
+        .def_readwrite("grad_tol", &TimeAllocatorSettings::grad_tol)
+        .def_readwrite("tfweight", &TimeAllocatorSettings::tfweight)
+        .def_readwrite("log", &TimeAllocatorSettings::log)
+        .def_readwrite("split_axes", &TimeAllocatorSettings::split_axes)
+        .def_readwrite("banded_ipm", &TimeAllocatorSettings::banded_ipm)
+        .def_readwrite("predict_solution", &TimeAllocatorSettings::predict_solution)
+        .def_readwrite("line_search_threads", &TimeAllocatorSettings::line_search_threads)
+        .def_readwrite("newton_step", &TimeAllocatorSettings::newton_step)
+        .def_readwrite("print_level", &TimeAllocatorSettings::print_level)
+        .def_readwrite("collect_stats", &TimeAllocatorSettings::collect_stats)
+        .def_readwrite("verbose", &TimeAllocatorSettings::verbose)
+        ;
+
+    py::class_<PlannerStats>(m, "PlannerStats")
+        .def(py::init<>())
+        .def_readonly("n_var", &PlannerStats::n_var)
+        .def_readonly("n_con", &PlannerStats::n_con)
+        .def_readonly("nnz_P", &PlannerStats::nnz_P)
+        .def_readonly("nnz_A", &PlannerStats::nnz_A)
+        .def_readonly("n_assembly", &PlannerStats::n_assembly)
+        .def_readonly("n_solve", &PlannerStats::n_solve)
+        .def_readonly("n_solve_failed", &PlannerStats::n_solve_failed)
+        .def_readonly("n_gradient", &PlannerStats::n_gradient)
+        .def_readonly("n_trial", &PlannerStats::n_trial)
+        .def_readonly("n_rejected", &PlannerStats::n_rejected)
+        .def_readonly("n_workspace_alloc", &PlannerStats::n_workspace_alloc)
+        .def_readonly("n_analyze", &PlannerStats::n_analyze)
+        .def_readonly("n_factorize", &PlannerStats::n_factorize)
+        .def_readonly("t_assembly", &PlannerStats::t_assembly)
+        .def_readonly("t_solve", &PlannerStats::t_solve)
+        .def_readonly("t_gradient", &PlannerStats::t_gradient)
+        .def_readonly("t_line_search", &PlannerStats::t_line_search)
+        .def_readonly("t_refine", &PlannerStats::t_refine)
+        .def("reset", &PlannerStats::reset)
+        ;
+
+    py::class_<TimeAllocator>(m, "TimeAllocator")
+        .def(py::init<const pyTGProblem&, const MatrixXd&, const TimeAllocatorSettings&>(),
+                "tgp"_a, "MQM"_a, "settings"_a = TimeAllocatorSettings())
+        .def("solve_with_room_time", &TimeAllocator::solve_with_room_time)
+        .def("solve_once", &TimeAllocator::solve_once)
+        .def("set_warm_start", &TimeAllocator::set_warm_start, "x"_a, "lmdy"_a, "lmdz"_a)
+        .def("set_solution", &TimeAllocator::set_solution, "room_time"_a, "x"_a, "lmdy"_a, "lmdz"_a, "obj"_a)
+        .def("segment_activity", &TimeAllocator::segment_activity)
+        .def("get_gradient", &TimeAllocator::get_gradient)
+        .def("compute_sensitivity", &TimeAllocator::compute_sensitivity)
+        .def("solve_with_prediction", &TimeAllocator::solve_with_prediction)
+        .def("hessian_vector_product_fd", [](TimeAllocator &ta, const VX &v) -> py::object {
+                VX hv;
+                if(!ta.hessian_vector_product_fd(v, hv))
+                    return py::none();
+                return py::cast(hv);
+            }, "v"_a)
+        .def("get_hessian", [](TimeAllocator &ta) -> py::object {
+                MatrixXd H;
+                if(!ta.get_hessian(H))
+                    return py::none();
+                return py::cast(H);
+            })
+        .def("get_gradient_fd", &TimeAllocator::get_gradient_fd, py::call_guard<py::gil_scoped_release>(),
+                "h"_a = 1e-6, "central"_a = false, "num_threads"_a = 0)
+        .def("get_gradient_mellinger", &TimeAllocator::get_gradient_mellinger, py::call_guard<py::gil_scoped_release>(),
+                "h"_a = 1e-6, "central"_a = false, "num_threads"_a = 0)
+        .def("refine_time_by_backtrack", &TimeAllocator::refine_time_by_backtrack)
+        .def("num_box", &TimeAllocator::num_box)
+        .def_readwrite("settings", &TimeAllocator::settings)
+        .def_property_readonly("qp", [](TimeAllocator &ta) -> QPSolver& {return ta.qp;}, py::return_value_policy::reference_internal)
+        .def_property_readonly("ipm", [](TimeAllocator &ta) -> BandedIPMSolver& {return ta.ipm;}, py::return_value_policy::reference_internal)
+        .def_readonly("room_time", &TimeAllocator::room_time)
+        .def_readonly("sol", &TimeAllocator::sol)
+        .def_readonly("lmdy", &TimeAllocator::lmdy)
+        .def_readonly("lmdz", &TimeAllocator::lmdz)
+        .def_readonly("obj", &TimeAllocator::obj)
+        .def_readonly("is_solved", &TimeAllocator::is_solved)
+        .def_readonly("major_iteration", &TimeAllocator::major_iteration)
+        .def_readonly("num_prob_solve", &TimeAllocator::num_prob_solve)
+        .def_readonly("time_cost", &TimeAllocator::time_cost)
+        .def_readonly("converge_reason", &TimeAllocator::converge_reason)
+        .def_readonly("log", &TimeAllocator::log)
+        .def_readwrite("stats", &TimeAllocator::stats)
+        ;
+
+    typedef py::array_t<double, py::array::c_style | py::array::forcecast> DoubleArray;
+    py::class_<TrajectoryEvaluator>(m, "TrajectoryEvaluator")
+        .def(py::init<const MatrixXd&, const VX&, const VX&>(), "M"_a, "sol"_a, "room_time"_a)
+        .def("set_solution", &TrajectoryEvaluator::set_solution, "sol"_a, "room_time"_a)
+        // an (n, max_deriv + 1, 3) array, written into out if given so a control loop can reuse one buffer
+        .def("evaluate", [](const TrajectoryEvaluator &ev, DoubleArray times, int max_deriv, py::object out){
+                ssize_t n = times.size();
+                std::vector<ssize_t> shape{n, (ssize_t)max_deriv + 1, 3};
+                py::array_t<double> result;
+                if(out.is_none())
+                    result = py::array_t<double>(shape);
+                else{
+                    if(!py::isinstance<py::array_t<double, py::array::c_style> >(out))
+                        throw py::value_error("out must be a C contiguous float64 array");
+                    result = out.cast<py::array_t<double> >();
+                    if(result.ndim() != 3 || result.shape(0) != n || result.shape(1) != max_deriv + 1 || result.shape(2) != 3)
+                        throw py::value_error("out must have shape (len(times), max_deriv + 1, 3)");
+                }
+                const double *t = times.data();
+                double *o = result.mutable_data();
+                {
+                    py::gil_scoped_release release;
+                    ev.evaluate(t, n, max_deriv, o);
+                }
+                return result;
+            }, "times"_a, "max_deriv"_a = 3, "out"_a = py::none())
+        .def("locate", &TrajectoryEvaluator::locate)
+        .def("num_segment", &TrajectoryEvaluator::num_segment)
+        .def("order", &TrajectoryEvaluator::order)
+        .def("total_time", &TrajectoryEvaluator::total_time)
+        ;
+
+    py::class_<TraceRecorder>(m, "TraceRecorder")
+        .def(py::init<size_t>(), "capacity"_a = 1 << 16)
+        .def("clear", &TraceRecorder::clear)
+        .def("capacity", &TraceRecorder::capacity)
+        .def("size", &TraceRecorder::size)
+        .def("dropped", &TraceRecorder::dropped)
+        .def("to_json", &TraceRecorder::to_json)
+        .def("write_json", &TraceRecorder::write_json)
+        ;
+
+    // the module holds a reference to the recorder while it is set, never freed so it outlives the interpreter
+    static py::object *current_tracer = new py::object();
+    m.def("set_tracer", [](py::object tracer){
+                set_tracer(tracer.is_none() ? nullptr : tracer.cast<TraceRecorder*>());
+                *current_tracer = tracer;
+            }, "tracer"_a);
+
+    py::class_<BatchOptions>(m, "BatchOptions")
+        .def(py::init<>())
+        .def_readwrite("settings", &BatchOptions::settings)
+        .def_readwrite("qp_settings", &BatchOptions::qp_settings)
+        .def_readwrite("num_threads", &BatchOptions::num_threads)
+        .def_readwrite("refine", &BatchOptions::refine)
+        ;
+
+    py::class_<BatchResult>(m, "BatchResult")
+        .def(py::init<>())
+        .def_readonly("is_solved", &BatchResult::is_solved)
+        .def_readonly("is_okay", &BatchResult::is_okay)
+        .def_readonly("converged", &BatchResult::converged)
+        .def_readonly("initial_obj", &BatchResult::initial_obj)
+        .def_readonly("obj", &BatchResult::obj)
+        .def_readonly("room_time", &BatchResult::room_time)
+        .def_readonly("sol", &BatchResult::sol)
+        .def_readonly("major_iteration", &BatchResult::major_iteration)
+        .def_readonly("num_prob_solve", &BatchResult::num_prob_solve)
+        .def_readonly("converge_reason", &BatchResult::converge_reason)
+        .def_readonly("solve_time", &BatchResult::solve_time)
+        .def_readonly("worker", &BatchResult::worker)
+        .def_readonly("stats", &BatchResult::stats)
+        ;
+
+    m.def("solve_batch", [](const std::vector<pyTGProblem> &problems, const MatrixXd &MQM, const BatchOptions &options){
+                std::vector<TGProblem> probs(problems.begin(), problems.end());
+                py::gil_scoped_release release;
+                return solve_batch(probs, MQM, options);
+            }, "problems"_a, "MQM"_a, "options"_a = BatchOptions());
+
+    py::class_<RecedingHorizonPlanner>(m, "RecedingHorizonPlanner")
+        .def(py::init<const pyTGProblem&, const MatrixXd&, const TimeAllocatorSettings&>(),
+                "tgp"_a, "MQM"_a, "settings"_a = TimeAllocatorSettings())
+        .def("drop_front", &RecedingHorizonPlanner::drop_front)
+        .def("append_boxes", &RecedingHorizonPlanner::append_boxes)
+        .def("set_start_state", &RecedingHorizonPlanner::set_start_state, "pos"_a, "vel"_a, "acc"_a)
+        .def("set_end_state", &RecedingHorizonPlanner::set_end_state, "pos"_a, "vel"_a, "acc"_a)
+        .def("replan", &RecedingHorizonPlanner::replan, py::call_guard<py::gil_scoped_release>())
+        .def("problem", [](const RecedingHorizonPlanner &rh){return pyTGProblem(rh.problem());})
+        .def("num_box", &RecedingHorizonPlanner::num_box)
+        .def("has_plan", &RecedingHorizonPlanner::has_plan)
+        .def_property_readonly("allocator", &RecedingHorizonPlanner::allocator, py::return_value_policy::reference_internal)
+        .def_readwrite("settings", &RecedingHorizonPlanner::settings)
+        .def_readwrite("qp_settings", &RecedingHorizonPlanner::qp_settings)
+        .def_readonly("num_replan", &RecedingHorizonPlanner::num_replan)
+        .def_readonly("num_warm_start", &RecedingHorizonPlanner::num_warm_start)
+        ;
+
+    m.def("loadTGP", &loadTGP);  // reads both the Boost text archive and the binary layout of tgp_binary.h
+    m.def("saveTGPBinary", &saveTGPBinary);
     m.def("printTGP", &printTGP);
+    m.def("sliceCorridor", [](pyTGProblem &tgp, const std::vector<char> &directions, unsigned int times){
+                return sliceCorridor(tgp, directions, times);
+            }, "tgp"_a, "directions"_a, "times"_a);
+    // returns the number of boxes sliced and the directions of the new corridor
+    m.def("sliceCorridorAdaptive", [](pyTGProblem &tgp, std::vector<char> directions, unsigned int max_slices,
+                const VX &activity, double tol){
+                int num_slice = sliceCorridorAdaptive(tgp, directions, max_slices, activity, tol);
+                return std::make_pair(num_slice, directions);
+            }, "tgp"_a, "directions"_a, "max_slices"_a, "activity"_a, "tol"_a = 1e-6);
     m.def("printBox", &printBox);
 
 
@@ -165,13 +446,36 @@ PYBIND11_MODULE(libott, m){
 
     m.def("construct_A", &construct_A_matrix);
 
+    /* Assembles in the buffers of the workspace and returns them without a copy, alive as long as ws is. The next
+     * assembly into ws overwrites them, and reallocates them if the shape changes, so numpy views taken from the
+     * result are only valid until then. Copy what has to outlive it.
+     */
+    m.def("assemble_A", [](ProblemWorkspace &ws, const vector<pyBox> &corridor, const MatrixXd &MQM, const MatrixXd &pos,
+                const MatrixXd &vel, const MatrixXd &acc, double maxVel, double maxAcc, int traj_order, double minimize_order,
+                double margin, bool isLimitVel, bool isLimitAcc) -> const LinearConstr & {
+                return assemble_A_matrix(ws, corridor, MQM, pos, vel, acc, maxVel, maxAcc, traj_order, minimize_order,
+                            margin, isLimitVel, isLimitAcc);
+            }, py::return_value_policy::reference_internal);
+
     m.def("gradient_from_P", &gradient_from_P);
 
-    m.def("gradient_from_A", &gradient_from_A);
+    m.def("gradient_from_A", static_cast<VX (*)(const vector<pyBox>&, const MatrixXd&, const MatrixXd&, const MatrixXd&,
+                const MatrixXd&, double, double, int, double, double, const bool&, const bool&, cRefVX, cRefVX, cRefVX)>(&gradient_from_A));
+
+    // computes in the buffers of ws, which keeps its assembled constraints; the result is copied out
+    m.def("gradient_from_A", static_cast<const VX &(*)(ProblemWorkspace&, const vector<pyBox>&, const MatrixXd&, const MatrixXd&,
+                const MatrixXd&, const MatrixXd&, double, double, int, double, double, const bool&, const bool&, cRefVX, cRefVX,
+                cRefVX)>(&gradient_from_A), py::return_value_policy::copy);
 
     m.def("set_print_level", &set_print_level);
 
-    m.def("snopt_eval", &snopt_eval);
+    m.def("snopt_eval", static_cast<std::pair<int, int> (*)(const vector<pyBox>&, const MatrixXd&, const MatrixXd&,
+                const MatrixXd&, const MatrixXd&, double, double, int, double, double, const bool&, const bool&, cRefVX, RefVX,
+                RefVX, RefVX, RefVX, ReflVX, ReflVX, bool, bool, bool)>(&snopt_eval));
+
+    m.def("snopt_eval", static_cast<std::pair<int, int> (*)(ProblemWorkspace&, const vector<pyBox>&, const MatrixXd&,
+                const MatrixXd&, const MatrixXd&, const MatrixXd&, double, double, int, double, double, const bool&, const bool&,
+                cRefVX, RefVX, RefVX, RefVX, RefVX, ReflVX, ReflVX, bool, bool, bool)>(&snopt_eval));
 
     m.def("eval_f", &eval_f);
 
@@ -0,0 +1,683 @@
+/*
+ * qp_solver.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "ott/qp_solver.h"
+
+
+const double QP_INF = std::numeric_limits<double>::infinity();
+const double RHO_MIN = 1e-6;
+const double RHO_MAX = 1e6;
+const double RHO_EQ_SCALE = 1e3;  // equality rows get a much larger step size
+const double SCALING_MIN = 1e-4;
+const double SCALING_MAX = 1e4;
+
+
+// clip a norm used for scaling so we never divide by something tiny or blow up
+static double clip_scaling(double v){
+    if(v < SCALING_MIN)
+        return 1.0;
+    return std::min(v, SCALING_MAX);
+}
+
+
+bool CachedLDLT::factorize_cached(const SpMX &K){
+    if(!K.isCompressed()){
+        SpMX Kc = K;
+        Kc.makeCompressed();
+        return factorize_cached(Kc);
+    }
+    const int *op = K.outerIndexPtr(), *ip = K.innerIndexPtr();
+    int n_outer = K.outerSize() + 1, nnz = K.nonZeros();
+    bool same = n_analyze > 0 && (int)outer.size() == n_outer && (int)inner.size() == nnz
+                && std::equal(outer.begin(), outer.end(), op) && std::equal(inner.begin(), inner.end(), ip);
+    if(!same){
+        analyzePattern(K);
+        outer.assign(op, op + n_outer);
+        inner.assign(ip, ip + nnz);
+        n_analyze++;
+    }
+    factorize(K);
+    n_factorize++;
+    return info() == Eigen::Success;
+}
+
+
+void QPSolver::reset(){
+    x_prev.resize(0);
+    z_prev.resize(0);
+    y_prev.resize(0);
+    rho = settings.rho;
+    status = QP_UNSOLVED;
+}
+
+
+void QPSolver::take_solution(const QPSolver &other){
+    QPSettings own_settings = settings;
+    int hits = active_set_hits, misses = active_set_misses, accepts = warm_start_accepts;
+    *this = other;  // CachedLDLT ignores the assignment, so the factorizations and their counts stay as well
+    settings = own_settings;
+    active_set_hits = hits;
+    active_set_misses = misses;
+    warm_start_accepts = accepts;
+}
+
+
+void QPSolver::reset_counters(){
+    active_set_hits = active_set_misses = warm_start_accepts = 0;
+    ldlt.n_analyze = ldlt.n_factorize = 0;
+    polish_ldlt.n_analyze = polish_ldlt.n_factorize = 0;
+}
+
+
+void QPSolver::add_counters(const QPSolver &other){
+    active_set_hits += other.active_set_hits;
+    active_set_misses += other.active_set_misses;
+    warm_start_accepts += other.warm_start_accepts;
+    ldlt.n_analyze += other.ldlt.n_analyze;
+    ldlt.n_factorize += other.ldlt.n_factorize;
+    polish_ldlt.n_analyze += other.polish_ldlt.n_analyze;
+    polish_ldlt.n_factorize += other.polish_ldlt.n_factorize;
+}
+
+
+// Ruiz equilibration of the KKT matrix [P C'; C 0], followed by a cost scaling
+void QPSolver::scale_data(const SpMX &P, cRefVX q, const SpMX &C, cRefVX l, cRefVX u){
+    Ps = P.selfadjointView<Eigen::Lower>();
+    Cs = C;
+    qs = q;
+    D = VX::Ones(n);
+    E = VX::Ones(m);
+    c = 1;
+
+    VX d_tmp(n), e_tmp(m);
+    for(int iter = 0; iter < settings.scaling_iter; iter++){
+        d_tmp.setZero();
+        e_tmp.setZero();
+        for(int j = 0; j < n; j++){
+            for(SpMX::InnerIterator it(Ps, j); it; ++it)
+                d_tmp(j) = std::max(d_tmp(j), std::abs(it.value()));
+            for(SpMX::InnerIterator it(Cs, j); it; ++it){
+                d_tmp(j) = std::max(d_tmp(j), std::abs(it.value()));
+                e_tmp(it.row()) = std::max(e_tmp(it.row()), std::abs(it.value()));
+            }
+        }
+        for(int j = 0; j < n; j++)
+            d_tmp(j) = 1.0 / std::sqrt(clip_scaling(d_tmp(j)));
+        for(int i = 0; i < m; i++)
+            e_tmp(i) = 1.0 / std::sqrt(clip_scaling(e_tmp(i)));
+
+        Ps = d_tmp.asDiagonal() * Ps * d_tmp.asDiagonal();
+        Cs = e_tmp.asDiagonal() * Cs * d_tmp.asDiagonal();
+        qs = d_tmp.cwiseProduct(qs);
+        D = D.cwiseProduct(d_tmp);
+        E = E.cwiseProduct(e_tmp);
+
+        // cost scaling
+        double mean_col = 0;
+        for(int j = 0; j < n; j++){
+            double col_norm = 0;
+            for(SpMX::InnerIterator it(Ps, j); it; ++it)
+                col_norm = std::max(col_norm, std::abs(it.value()));
+            mean_col += col_norm;
+        }
+        mean_col /= std::max(n, 1);
+        double q_norm = qs.size() > 0 ? qs.lpNorm<Eigen::Infinity>() : 0;
+        double c_tmp = 1.0 / clip_scaling(std::max(mean_col, q_norm));
+        Ps *= c_tmp;
+        qs *= c_tmp;
+        c *= c_tmp;
+    }
+    ls = E.cwiseProduct(l);
+    us = E.cwiseProduct(u);
+}
+
+
+void QPSolver::set_rho_vec(){
+    rho_vec.resize(m);
+    for(int i = 0; i < m; i++){
+        if(ls(i) == -QP_INF && us(i) == QP_INF)
+            rho_vec(i) = RHO_MIN;
+        else if(us(i) - ls(i) < 1e-12)
+            rho_vec(i) = RHO_EQ_SCALE * rho;
+        else
+            rho_vec(i) = rho;
+    }
+}
+
+
+// factorize the reduced KKT matrix P + sigma I + C' R C
+bool QPSolver::factorize(){
+    SpMX eye(n, n);
+    eye.setIdentity();
+    SpMX K = Ps + settings.sigma * eye;
+    K += SpMX(Cs.transpose() * rho_vec.asDiagonal() * Cs);
+    if(!ldlt.factorize_cached(K))
+        return false;
+    return ldlt.vectorD().minCoeff() > 0;
+}
+
+
+// residuals in the original (unscaled) problem
+void QPSolver::residuals(cRefVX xv, cRefVX zv, cRefVX yv, double &prim, double &dual, double &eps_prim, double &eps_dual) const {
+    VX Cx = Cs * xv;
+    VX Px = Ps * xv;
+    VX Cty = Cs.transpose() * yv;
+    prim = (Cx - zv).cwiseQuotient(E).lpNorm<Eigen::Infinity>();
+    eps_prim = settings.eps_abs + settings.eps_rel * std::max(Cx.cwiseQuotient(E).lpNorm<Eigen::Infinity>(),
+                                                              zv.cwiseQuotient(E).lpNorm<Eigen::Infinity>());
+    dual = (Px + qs + Cty).cwiseQuotient(D).lpNorm<Eigen::Infinity>() / c;
+    double max_dual = std::max(Px.cwiseQuotient(D).lpNorm<Eigen::Infinity>(), Cty.cwiseQuotient(D).lpNorm<Eigen::Infinity>());
+    max_dual = std::max(max_dual, qs.cwiseQuotient(D).lpNorm<Eigen::Infinity>());
+    eps_dual = settings.eps_abs + settings.eps_rel * max_dual / c;
+}
+
+
+// check if dy is a certificate of primal infeasibility
+bool QPSolver::is_primal_infeasible(cRefVX dy) const {
+    double norm_dy = E.cwiseProduct(dy).lpNorm<Eigen::Infinity>();
+    if(norm_dy <= settings.eps_prim_inf)
+        return false;
+    double bound_term = 0;
+    for(int i = 0; i < m; i++){
+        double dyi = dy(i) / norm_dy;
+        if(dyi > 0){
+            if(us(i) == QP_INF)
+                return false;
+            bound_term += us(i) * dyi;
+        }
+        else if(dyi < 0){
+            if(ls(i) == -QP_INF)
+                return false;
+            bound_term += ls(i) * dyi;
+        }
+    }
+    if(bound_term >= 0)
+        return false;
+    VX Cty = Cs.transpose() * dy / norm_dy;
+    return Cty.cwiseQuotient(D).lpNorm<Eigen::Infinity>() < settings.eps_prim_inf;
+}
+
+
+/* Solve the equality constrained QP that holds the rows with side -1 (1) at their lower (upper) bound and the
+ * equality rows (side 0) at their value, rows with side 2 are dropped,
+ *     [P + delta I   Ca'     ] [x]   [rx]
+ *     [Ca            -delta I] [y] = [rb]
+ * with iterative refinement, rb holds the right hand side of every row of C and only the kept ones are read.
+ * Returns false if the factorization fails, the signs of the multipliers are not checked.
+ */
+bool QPSolver::solve_equality_qp(const std::vector<int> &side, cRefVX rx, cRefVX rb, VX &x_eq, VX &y_eq){
+    std::vector<int> act_map(m, -1);
+    VX b_act(m);
+    int n_act = 0;
+    for(int i = 0; i < m; i++){
+        if(side[i] == 2)
+            continue;
+        act_map[i] = n_act;
+        b_act(n_act) = rb(i);
+        n_act++;
+    }
+
+    double delta = settings.polish_delta;
+    std::vector<Eigen::Triplet<double> > trip;
+    std::vector<Eigen::Triplet<double> > ctrip;
+    for(int j = 0; j < n; j++){
+        for(SpMX::InnerIterator it(Ps, j); it; ++it){
+            if(it.row() >= j)
+                trip.push_back(Eigen::Triplet<double>(it.row(), j, it.value()));
+        }
+        trip.push_back(Eigen::Triplet<double>(j, j, delta));
+        for(SpMX::InnerIterator it(Cs, j); it; ++it){
+            int r = act_map[it.row()];
+            if(r >= 0){
+                trip.push_back(Eigen::Triplet<double>(n + r, j, it.value()));
+                ctrip.push_back(Eigen::Triplet<double>(r, j, it.value()));
+            }
+        }
+    }
+    for(int r = 0; r < n_act; r++)
+        trip.push_back(Eigen::Triplet<double>(n + r, n + r, -delta));
+    SpMX kkt(n + n_act, n + n_act);
+    kkt.setFromTriplets(trip.begin(), trip.end());
+    SpMX Ca(n_act, n);
+    Ca.setFromTriplets(ctrip.begin(), ctrip.end());
+
+    if(!polish_ldlt.factorize_cached(kkt))
+        return false;
+
+    VX rhs(n + n_act);
+    rhs.head(n) = rx;
+    rhs.tail(n_act) = b_act.head(n_act);
+    VX sol = polish_ldlt.solve(rhs);
+    // the active constraints can be degenerate (e.g. a bound on a point also fixed by the boundary condition)
+    // so the regularized system is close to singular and refinement does the real work
+    double rhs_norm = rhs.lpNorm<Eigen::Infinity>();
+    VX res(n + n_act);
+    for(int k = 0; k < settings.polish_refine_iter; k++){
+        res.head(n) = rhs.head(n) - Ps * sol.head(n) - Ca.transpose() * sol.tail(n_act);
+        res.tail(n_act) = rhs.tail(n_act) - Ca * sol.head(n);
+        if(res.lpNorm<Eigen::Infinity>() < 1e-13 * (1 + rhs_norm))
+            break;
+        sol += polish_ldlt.solve(res);
+    }
+
+    x_eq = sol.head(n);
+    y_eq = VX::Zero(m);
+    for(int i = 0; i < m; i++)
+        if(act_map[i] >= 0)
+            y_eq(i) = sol(n + act_map[i]);
+    return true;
+}
+
+
+// the bounds a row is held at, lower for equality rows
+VX QPSolver::active_bounds(const std::vector<int> &side, cRefVX lower, cRefVX upper) const{
+    VX b(m);
+    for(int i = 0; i < m; i++)
+        b(i) = (side[i] == 1) ? upper(i) : lower(i);
+    return b;
+}
+
+
+// equality rows and the rows whose multiplier in y (unscaled, over the rows of C) is nonzero
+std::vector<int> QPSolver::active_side(cRefVX y) const{
+    std::vector<int> side(m, 2);
+    for(int i = 0; i < m; i++){
+        if(us(i) - ls(i) < 1e-12)
+            side[i] = 0;
+        else if(y(i) > settings.eps_abs)
+            side[i] = 1;
+        else if(y(i) < -settings.eps_abs)
+            side[i] = -1;
+    }
+    return side;
+}
+
+
+// multiplier of an active lower (upper) bound cannot be positive (negative)
+bool QPSolver::wrong_sign(int side, int i, double yi) const{
+    return side * yi * E(i) / c < -settings.eps_abs;
+}
+
+
+/* Guess the active set from the ADMM iterate and solve the equality constrained QP on it.
+ * Accept the result if it is at least as good as the ADMM iterate, or if require_tol is set,
+ * if it meets the termination tolerance by itself.
+ */
+bool QPSolver::polish_solution(bool require_tol){
+    std::vector<int> side(m, 2);  // -1 lower, 1 upper, 0 equality, 2 inactive
+    for(int i = 0; i < m; i++){
+        if(us(i) - ls(i) < 1e-12)
+            side[i] = 0;
+        else if(zs(i) - ls(i) < -ys(i))
+            side[i] = -1;
+        else if(us(i) - zs(i) < ys(i))
+            side[i] = 1;
+    }
+    VX x_pol, y_pol;
+    if(!solve_equality_qp(side, -qs, active_bounds(side, ls, us), x_pol, y_pol))
+        return false;
+    for(int i = 0; i < m; i++)
+        if(wrong_sign(side[i], i, y_pol(i)))
+            return false;
+    VX z_pol = (Cs * x_pol).cwiseMax(ls).cwiseMin(us);
+
+    double pol_prim, pol_dual, eps_prim, eps_dual;
+    residuals(x_pol, z_pol, y_pol, pol_prim, pol_dual, eps_prim, eps_dual);
+    bool accept;
+    if(require_tol)
+        accept = pol_prim < eps_prim && pol_dual < eps_dual;
+    else
+        accept = pol_prim < std::max(prim_res, 1e-10) && pol_dual < std::max(dual_res, 1e-10);
+    if(accept){
+        xs = x_pol;
+        zs = z_pol;
+        ys = y_pol;
+        prim_res = pol_prim;
+        dual_res = pol_dual;
+        return true;
+    }
+    return false;
+}
+
+
+/* Take the rows with a nonzero multiplier in the previous solution (or the warm start) as the active set and solve the equality
+ * constrained QP on it. Between line search trials the active set changes little, so after at most
+ * settings.active_set_updates corrections (release rows whose multiplier has the wrong sign, add rows that are violated)
+ * the result is usually feasible with multipliers of the right signs, i.e. it satisfies the KKT conditions
+ * and ADMM is skipped altogether.
+ */
+bool QPSolver::solve_previous_active_set(){
+    std::vector<int> side = active_side(y_prev);
+    VX x_act, y_act, Cx;
+    for(int k = 0; ; k++){
+        if(!solve_equality_qp(side, -qs, active_bounds(side, ls, us), x_act, y_act))
+            return false;
+        Cx = Cs * x_act;
+        bool changed = false;
+        for(int i = 0; i < m; i++){
+            if(side[i] == 0)
+                continue;
+            if(side[i] != 2 && wrong_sign(side[i], i, y_act(i))){
+                side[i] = 2;
+                changed = true;
+            }
+            else if(side[i] == 2 && (Cx(i) - us(i)) / E(i) > settings.eps_abs){
+                side[i] = 1;
+                changed = true;
+            }
+            else if(side[i] == 2 && (ls(i) - Cx(i)) / E(i) > settings.eps_abs){
+                side[i] = -1;
+                changed = true;
+            }
+        }
+        if(!changed)
+            break;
+        if(k == settings.active_set_updates)
+            return false;
+    }
+    VX z_act = Cx.cwiseMax(ls).cwiseMin(us);
+    double prim, dual, eps_prim, eps_dual;
+    residuals(x_act, z_act, y_act, prim, dual, eps_prim, eps_dual);
+    if(prim >= eps_prim || dual >= eps_dual)
+        return false;
+    xs = x_act;
+    zs = z_act;
+    ys = y_act;
+    prim_res = prim;
+    dual_res = dual;
+    return true;
+}
+
+
+/* Accept the warm start as it is if it satisfies the termination tolerances and complementarity, i.e. each row with a
+ * nonzero multiplier is at its bound. Only an accurate prediction passed to set_warm_start can be.
+ */
+bool QPSolver::accept_warm_start(){
+    VX x_w = x_prev.cwiseQuotient(D);
+    VX y_w = c * y_prev.cwiseQuotient(E);
+    VX Cx = Cs * x_w;
+    VX z_w = Cx.cwiseMax(ls).cwiseMin(us);
+    double prim, dual, eps_prim, eps_dual;
+    residuals(x_w, z_w, y_w, prim, dual, eps_prim, eps_dual);
+    if(prim >= eps_prim || dual >= eps_dual)
+        return false;
+    for(int i = 0; i < m; i++){
+        if(y_w(i) > 0 && (us(i) - Cx(i)) / E(i) > eps_prim)
+            return false;
+        if(y_w(i) < 0 && (Cx(i) - ls(i)) / E(i) > eps_prim)
+            return false;
+    }
+    xs = x_w;
+    zs = z_w;
+    ys = y_w;
+    prim_res = prim;
+    dual_res = dual;
+    return true;
+}
+
+
+void QPSolver::set_warm_start(cRefVX x_w, cRefVX z_w, cRefVX y_w){
+    x_prev = x_w;
+    z_prev = z_w;
+    y_prev = y_w;
+}
+
+
+QPSolver::WarmStart QPSolver::get_warm_start() const{
+    WarmStart ws;
+    ws.x = x_prev;
+    ws.z = z_prev;
+    ws.y = y_prev;
+    ws.rho = rho;
+    return ws;
+}
+
+
+void QPSolver::restore_warm_start(const WarmStart &ws){
+    x_prev = ws.x;
+    z_prev = ws.z;
+    y_prev = ws.y;
+    rho = ws.rho;
+}
+
+
+/* Differentiate the KKT system on the active set of the last solution,
+ *     [P   Ca'] [dx]   [-(dP x + dq + dCa' y)]
+ *     [Ca  0  ] [dy] = [db - dCa x           ]
+ * where db are the derivatives of the bounds the active rows are held at. It is the same system as the one of the
+ * active set solve, so the cached factorization pattern is reused.
+ */
+bool QPSolver::sensitivity(const SpMX &dP, cRefVX dq, const SpMX &dA, cRefVX dclb, cRefVX dcub, cRefVX dxlb, cRefVX dxub,
+                           VX &dx, VX &dlmdy, VX &dlmdz){
+    int n_con = dA.rows();
+    if(status != QP_SOLVED || y_prev.size() != m || n_con + n != m || dP.cols() != n)
+        return false;
+    SpMX dC(m, n);
+    {
+        std::vector<Eigen::Triplet<double> > trip;
+        trip.reserve(dA.nonZeros());
+        for(int j = 0; j < dA.outerSize(); j++)
+            for(SpMX::InnerIterator it(dA, j); it; ++it)
+                trip.push_back(Eigen::Triplet<double>(it.row(), j, it.value()));
+        dC.setFromTriplets(trip.begin(), trip.end());
+    }
+    SpMX dPs = c * D.asDiagonal() * SpMX(dP.selfadjointView<Eigen::Lower>()) * D.asDiagonal();
+    SpMX dCs = E.asDiagonal() * dC * D.asDiagonal();
+    VX dl(m), du(m);
+    dl << dclb, dxlb;
+    du << dcub, dxub;
+    dl = E.cwiseProduct(dl);
+    du = E.cwiseProduct(du);
+
+    std::vector<int> side = active_side(y_prev);
+    VX rx = -(dPs * xs + c * D.cwiseProduct(dq) + dCs.transpose() * ys);
+    VX rb = active_bounds(side, dl, du) - dCs * xs;
+    VX dxs, dys;
+    if(!solve_equality_qp(side, rx, rb, dxs, dys))
+        return false;
+    dx = D.cwiseProduct(dxs);
+    VX dy = E.cwiseProduct(dys) / c;
+    dlmdy = dy.head(n_con);
+    dlmdz = dy.tail(n);
+    return true;
+}
+
+
+void QPSolver::unscale_solution(int n_con){
+    x = D.cwiseProduct(xs);
+    VX y = E.cwiseProduct(ys) / c;
+    lmdy = y.head(n_con);
+    lmdz = y.tail(n);
+    obj = (0.5 * xs.dot(Ps * xs) + qs.dot(xs)) / c;
+    x_prev = x;
+    z_prev = zs.cwiseQuotient(E);
+    y_prev = y;
+}
+
+
+// a failed solve must not leave the results of the one before it
+void QPSolver::clear_solution(int n_con){
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    x.setConstant(n, nan);
+    lmdy.setConstant(n_con, nan);
+    lmdz.setConstant(n, nan);
+    obj = nan;
+}
+
+
+int QPSolver::solve(const SpMX &P, cRefVX q, const SpMX &A, cRefVX clb, cRefVX cub, cRefVX xlb, cRefVX xub){
+    int n_var = xlb.size();
+    int n_con = A.rows();
+
+    // stack the bounds on variables below the linear constraints, C = [A; I]
+    SpMX C(n_con + n_var, n_var);
+    {
+        std::vector<Eigen::Triplet<double> > trip;
+        trip.reserve(A.nonZeros() + n_var);
+        for(int j = 0; j < A.outerSize(); j++)
+            for(SpMX::InnerIterator it(A, j); it; ++it)
+                trip.push_back(Eigen::Triplet<double>(it.row(), j, it.value()));
+        for(int j = 0; j < n_var; j++)
+            trip.push_back(Eigen::Triplet<double>(n_con + j, j, 1.0));
+        C.setFromTriplets(trip.begin(), trip.end());
+    }
+    VX l(n_con + n_var), u(n_con + n_var);
+    l << clb, xlb;
+    u << cub, xub;
+
+    bool warm = settings.warm_start && x_prev.size() == n_var && z_prev.size() == n_con + n_var;
+    n = n_var;
+    m = n_con + n_var;
+    polished = false;
+    active_set_hit = false;
+    iter = 0;
+
+    scale_data(P, q, C, l, u);
+    if(warm && accept_warm_start()){
+        warm_start_accepts++;
+        status = QP_SOLVED;
+        unscale_solution(n_con);
+        return status;
+    }
+    if(warm && settings.active_set_fast_path && y_prev.size() == m){
+        if(solve_previous_active_set()){
+            active_set_hit = true;
+            active_set_hits++;
+            status = QP_SOLVED;
+            unscale_solution(n_con);
+            return status;
+        }
+        active_set_misses++;
+    }
+
+    if(!warm)
+        rho = settings.rho;
+    set_rho_vec();
+    if(!factorize()){
+        status = QP_NON_CVX;
+        clear_solution(n_con);
+        return status;
+    }
+
+    if(warm){
+        xs = x_prev.cwiseQuotient(D);
+        zs = E.cwiseProduct(z_prev);
+        ys = c * y_prev.cwiseQuotient(E);
+    }
+    else{
+        xs = VX::Zero(n);
+        zs = VX::Zero(m);
+        ys = VX::Zero(m);
+    }
+
+    const double alpha = settings.alpha;
+    const double sigma = settings.sigma;
+    VX rhs(n), xt(n), zt(m), v(m), y_old(m);
+    double eps_prim = 0, eps_dual = 0;
+    status = QP_MAX_ITER_REACHED;
+    for(iter = 1; iter <= settings.max_iter; iter++){
+        bool check = (iter % settings.check_interval == 0) || iter == settings.max_iter;
+        if(check)
+            y_old = ys;
+
+        rhs = sigma * xs - qs + Cs.transpose() * (rho_vec.cwiseProduct(zs) - ys);
+        xt = ldlt.solve(rhs);
+        zt = Cs * xt;
+        xs = alpha * xt + (1 - alpha) * xs;
+        v = alpha * zt + (1 - alpha) * zs;
+        zs = (v + ys.cwiseQuotient(rho_vec)).cwiseMax(ls).cwiseMin(us);
+        ys += rho_vec.cwiseProduct(v - zs);
+
+        if(!check)
+            continue;
+
+        residuals(xs, zs, ys, prim_res, dual_res, eps_prim, eps_dual);
+        if(prim_res < eps_prim && dual_res < eps_dual){
+            status = QP_SOLVED;
+            break;
+        }
+        // ADMM is slow to reach high accuracy, but finds the active set early on
+        if(settings.polish && settings.polish_interval > 0 && iter % settings.polish_interval == 0 && polish_solution(true)){
+            polished = true;
+            status = QP_SOLVED;
+            break;
+        }
+        if(is_primal_infeasible(ys - y_old)){
+            status = QP_PRIMAL_INFEASIBLE;
+            break;
+        }
+
+        if(settings.adaptive_rho && iter % settings.adaptive_rho_interval == 0){
+            VX Cx = Cs * xs;
+            VX Px = Ps * xs;
+            VX Cty = Cs.transpose() * ys;
+            double prim_norm = std::max(Cx.lpNorm<Eigen::Infinity>(), zs.lpNorm<Eigen::Infinity>());
+            double dual_norm = std::max(std::max(Px.lpNorm<Eigen::Infinity>(), Cty.lpNorm<Eigen::Infinity>()),
+                                        qs.size() > 0 ? qs.lpNorm<Eigen::Infinity>() : 0);
+            double prim_ratio = (Cx - zs).lpNorm<Eigen::Infinity>() / (prim_norm + 1e-10);
+            double dual_ratio = (Px + qs + Cty).lpNorm<Eigen::Infinity>() / (dual_norm + 1e-10);
+            double new_rho = rho * std::sqrt(prim_ratio / (dual_ratio + 1e-10));
+            new_rho = std::min(std::max(new_rho, RHO_MIN), RHO_MAX);
+            if(new_rho > rho * settings.adaptive_rho_tolerance || new_rho < rho / settings.adaptive_rho_tolerance){
+                rho = new_rho;
+                set_rho_vec();
+                if(!factorize()){
+                    status = QP_NON_CVX;
+                    clear_solution(n_con);
+                    return status;
+                }
+            }
+        }
+    }
+    if(iter > settings.max_iter)
+        iter = settings.max_iter;
+
+    if(settings.polish && !polished && (status == QP_SOLVED || status == QP_MAX_ITER_REACHED)){
+        polished = polish_solution(false);
+        if(polished && status == QP_MAX_ITER_REACHED){
+            residuals(xs, zs, ys, prim_res, dual_res, eps_prim, eps_dual);
+            if(prim_res < eps_prim && dual_res < eps_dual)
+                status = QP_SOLVED;
+        }
+    }
+
+    if(status == QP_PRIMAL_INFEASIBLE){
+        // the iterate is meaningless, do not warm start from it
+        x_prev.resize(0);
+        z_prev.resize(0);
+        y_prev.resize(0);
+        rho = settings.rho;
+        clear_solution(n_con);
+        return status;
+    }
+    unscale_solution(n_con);
+    if(status != QP_SOLVED)
+        clear_solution(n_con);  // but keep the iterate to warm start from
+    return status;
+}
+
+
+int QPSolver::solve_triplets(cRefVX pval, const lVX &prow, const lVX &pcol, const LinearConstr &lincon){
+    int n_var = lincon.n_var;
+    int n_con = lincon.n_con;
+    std::vector<Eigen::Triplet<double> > trip;
+    trip.reserve(pval.size());
+    for(int i = 0; i < pval.size(); i++)
+        trip.push_back(Eigen::Triplet<double>(prow(i), pcol(i), pval(i)));
+    SpMX P(n_var, n_var);
+    P.setFromTriplets(trip.begin(), trip.end());
+
+    Eigen::Map<const SpMX> A(n_con, n_var, lincon.n_nnz, lincon.colptr.data(), lincon.rowind.data(), lincon.values.data());
+
+    VX q = VX::Zero(n_var);
+    return solve(P, q, A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+}
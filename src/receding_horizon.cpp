@@ -0,0 +1,160 @@
+/*
+ * receding_horizon.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+#include "ott/receding_horizon.h"
+#include "ott/trace_recorder.h"
+
+
+/* Identify each row of A by the first segment it touches, whether it is an equality, the number of segments it spans
+ * and its columns relative to that segment. A constraint of a kept segment, or a joint between two kept segments, has
+ * the same key up to the segment in the corridor after dropping boxes, while the limits, the boundary conditions and
+ * the joints of a segment never collide since they differ in span, equality or columns.
+ */
+static std::vector<std::vector<int> > constraint_row_keys(const SpMX &A, cRefVX clb, cRefVX cub, int seg_size){
+    std::vector<std::vector<int> > cols(A.rows());
+    for(int j = 0; j < A.outerSize(); j++)
+        for(SpMX::InnerIterator it(A, j); it; ++it)
+            cols[it.row()].push_back(j);  // in increasing column order
+    std::vector<std::vector<int> > keys(A.rows());
+    for(int i = 0; i < A.rows(); i++){
+        if(cols[i].empty())
+            continue;
+        int seg0 = cols[i].front() / seg_size;
+        std::vector<int> &key = keys[i];
+        key.push_back(seg0);
+        key.push_back(clb(i) == cub(i));
+        key.push_back(cols[i].back() / seg_size - seg0 + 1);
+        for(int col : cols[i])
+            key.push_back(col - seg0 * seg_size);
+    }
+    return keys;
+}
+
+
+RecedingHorizonPlanner::RecedingHorizonPlanner(const TGProblem &tgp_, const MatrixXd &MQM_, const TimeAllocatorSettings &settings_):
+    settings(settings_),
+    tgp(tgp_),
+    MQM(MQM_)
+{}
+
+
+bool RecedingHorizonPlanner::drop_front(int n){
+    if(n < 0 || n >= (int)tgp.corridor.size()){
+        std::cout << "[Error]Cannot drop " << n << " of " << tgp.corridor.size() << " boxes" << std::endl;
+        return false;
+    }
+    tgp.corridor.erase(tgp.corridor.begin(), tgp.corridor.begin() + n);
+    plan.shift += n;
+    return true;
+}
+
+
+void RecedingHorizonPlanner::append_boxes(const std::vector<pyBox> &boxes){
+    double mean_t = 0;
+    for(auto &box : tgp.corridor)
+        mean_t += box.t / tgp.corridor.size();
+    for(auto &box : boxes){
+        tgp.corridor.push_back(box);
+        if(tgp.corridor.back().t <= 0)
+            tgp.corridor.back().t = mean_t;
+    }
+}
+
+
+void RecedingHorizonPlanner::set_start_state(const Eigen::Vector3d &pos, const Eigen::Vector3d &vel, const Eigen::Vector3d &acc){
+    tgp.position.row(0) = pos.transpose();
+    tgp.velocity.row(0) = vel.transpose();
+    tgp.acceleration.row(0) = acc.transpose();
+}
+
+
+void RecedingHorizonPlanner::set_end_state(const Eigen::Vector3d &pos, const Eigen::Vector3d &vel, const Eigen::Vector3d &acc){
+    tgp.position.row(1) = pos.transpose();
+    tgp.velocity.row(1) = vel.transpose();
+    tgp.acceleration.row(1) = acc.transpose();
+}
+
+
+/* Segment k of the new corridor was segment k + shift of the plan. New segments start at the center of their box,
+ * i.e. every control point there, and have zero multipliers like the constraints that did not exist before.
+ */
+void RecedingHorizonPlanner::warm_start(TimeAllocator &allocator) const{
+    const ConstraintMatrix &constraint = allocator.get_constraint();
+    const LinearConstr &lincon = constraint.lincon;
+    int n_seg = tgp.corridor.size();
+    int n_ctrl = tgp.trajectoryOrder + 1;
+    int seg_size = 3 * n_ctrl;
+
+    VX x(lincon.n_var), lz = VX::Zero(lincon.n_var), ly = VX::Zero(lincon.n_con);
+    for(int k = 0; k < n_seg; k++){
+        int old = k + plan.shift;
+        if(old < plan.num_seg){
+            x.segment(k * seg_size, seg_size) = plan.sol.segment(old * seg_size, seg_size);
+            lz.segment(k * seg_size, seg_size) = plan.lmdz.segment(old * seg_size, seg_size);
+        }
+        else{
+            const Box &box = tgp.corridor[k];
+            for(int p = 0; p < 3; p++)
+                x.segment(k * seg_size + p * n_ctrl, n_ctrl).setConstant(box.center(p) / box.t);  // sol is scaled by t
+        }
+    }
+
+    std::map<std::vector<int>, int> old_rows;
+    for(size_t i = 0; i < plan.row_keys.size(); i++){
+        std::vector<int> key = plan.row_keys[i];
+        if(key.empty() || key[0] < plan.shift)
+            continue;
+        key[0] -= plan.shift;
+        old_rows[key] = i;
+    }
+    std::vector<std::vector<int> > keys = constraint_row_keys(constraint.A, lincon.clb, lincon.cub, seg_size);
+    for(size_t i = 0; i < keys.size(); i++){
+        auto found = old_rows.find(keys[i]);
+        if(found != old_rows.end())
+            ly(i) = plan.lmdy(found->second);
+    }
+    allocator.set_warm_start(x, ly, lz);
+}
+
+
+std::pair<bool, bool> RecedingHorizonPlanner::replan(){
+    TraceSpan span("replan");
+    span.arg("segments", tgp.corridor.size());
+    span.arg("shift", plan.shift);
+    last.reset(new TimeAllocator(tgp, MQM, settings, &ws));
+    last->qp.settings = qp_settings;
+    for(int p = 0; p < 3; p++)
+        last->split_qp.qp[p].settings = qp_settings;
+    bool warm = plan.valid;
+    if(warm){
+        warm_start(*last);
+        num_warm_start++;
+    }
+    span.arg("warm", warm);
+    num_replan++;
+
+    last->solve_once();
+    std::pair<bool, bool> ret = last->refine_time_by_backtrack();
+    if(!last->is_solved)
+        return ret;
+
+    for(size_t i = 0; i < tgp.corridor.size(); i++)
+        tgp.corridor[i].t = last->room_time(i);
+    const LinearConstr &lincon = last->get_constraint().lincon;
+    plan.valid = true;
+    plan.num_seg = tgp.corridor.size();
+    plan.shift = 0;
+    plan.sol = last->sol;
+    plan.lmdy = last->lmdy;
+    plan.lmdz = last->lmdz;
+    plan.row_keys = constraint_row_keys(last->get_constraint().A, lincon.clb, lincon.cub, 3 * (tgp.trajectoryOrder + 1));
+    return ret;
+}
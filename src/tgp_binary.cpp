@@ -0,0 +1,237 @@
+/*
+ * tgp_binary.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "ott/tgp_binary.h"
+
+
+static bool host_is_little_endian(){
+    uint32_t one = 1;
+    char byte;
+    std::memcpy(&byte, &one, 1);
+    return byte == 1;
+}
+
+
+static uint64_t align8(uint64_t offset){
+    return (offset + 7) & ~uint64_t(7);
+}
+
+
+static void write_array(std::ofstream &ofs, uint64_t offset, const double *values, size_t n){
+    ofs.seekp(offset);
+    ofs.write(reinterpret_cast<const char*>(values), n * sizeof(double));
+}
+
+
+bool saveTGProblemToBinary(const TGProblem &problem, const std::string &fileName){
+    if(!host_is_little_endian()){
+        cout << "[Error]The binary TGProblem format is little-endian only." << endl;
+        return false;
+    }
+    uint32_t seg = problem.corridor.size();
+    TGPBinaryHeader hd;
+    std::memset(&hd, 0, sizeof(hd));
+    hd.magic = TGP_BINARY_MAGIC;
+    hd.version = TGP_BINARY_VERSION;
+    hd.header_size = sizeof(TGPBinaryHeader);
+    hd.segment_num = seg;
+    hd.trajectory_order = problem.trajectoryOrder;
+    hd.flags = (problem.doLimitVelocity ? TGP_LIMIT_VELOCITY : 0) | (problem.doLimitAcceleration ? TGP_LIMIT_ACCELERATION : 0);
+    hd.mqm_rows = problem.MQM.rows();
+    hd.mqm_cols = problem.MQM.cols();
+    hd.pos_rows = problem.position.rows();
+    hd.pos_cols = problem.position.cols();
+    hd.vel_rows = problem.velocity.rows();
+    hd.vel_cols = problem.velocity.cols();
+    hd.acc_rows = problem.acceleration.rows();
+    hd.acc_cols = problem.acceleration.cols();
+    hd.max_velocity = problem.maxVelocity;
+    hd.max_acceleration = problem.maxAcceleration;
+    hd.minimize_order = problem.minimizeOrder;
+    hd.margin = problem.margin;
+
+    uint64_t offset = align8(sizeof(TGPBinaryHeader));
+    hd.bounds_offset = offset;
+    offset += 6 * seg * sizeof(double);
+    hd.time_offset = offset;
+    offset += seg * sizeof(double);
+    hd.center_offset = offset;
+    offset += 3 * seg * sizeof(double);
+    hd.vertex_offset = offset;
+    offset += 24 * seg * sizeof(double);
+    hd.valid_offset = offset;
+    offset = align8(offset + seg);
+    hd.mqm_offset = offset;
+    offset += problem.MQM.size() * sizeof(double);
+    hd.pos_offset = offset;
+    offset += problem.position.size() * sizeof(double);
+    hd.vel_offset = offset;
+    offset += problem.velocity.size() * sizeof(double);
+    hd.acc_offset = offset;
+    offset += problem.acceleration.size() * sizeof(double);
+    hd.file_size = offset;
+
+    // gather the boxes into flat arrays, bounds come from the vertex the same way as Box::setBox
+    std::vector<double> bounds(6 * seg), time(seg), center(3 * seg), vertex(24 * seg);
+    std::vector<char> valid(seg);
+    for(uint32_t i = 0; i < seg; i++){
+        const Box &box = problem.corridor[i];
+        if(box.vertex.rows() != 8 || box.vertex.cols() != 3){
+            cout << "[Error]Box " << i << " does not have 8 x 3 vertex." << endl;
+            return false;
+        }
+        double bd[6] = {box.vertex(3, 0), box.vertex(0, 0), box.vertex(0, 1), box.vertex(1, 1), box.vertex(4, 2), box.vertex(1, 2)};
+        std::copy(bd, bd + 6, bounds.begin() + 6 * i);
+        time[i] = box.t;
+        for(int j = 0; j < 3; j++)
+            center[3 * i + j] = box.center(j);
+        std::copy(box.vertex.data(), box.vertex.data() + 24, vertex.begin() + 24 * i);
+        valid[i] = box.valid ? 1 : 0;
+    }
+
+    std::ofstream ofs(fileName, std::ios::binary | std::ios::trunc);
+    if(!ofs){
+        cout << "[Error]Cannot open " << fileName << " for writing." << endl;
+        return false;
+    }
+    // write zeros first so the padding between arrays is defined
+    std::vector<char> zeros(hd.file_size, 0);
+    ofs.write(zeros.data(), zeros.size());
+    ofs.seekp(0);
+    ofs.write(reinterpret_cast<const char*>(&hd), sizeof(hd));
+    write_array(ofs, hd.bounds_offset, bounds.data(), bounds.size());
+    write_array(ofs, hd.time_offset, time.data(), time.size());
+    write_array(ofs, hd.center_offset, center.data(), center.size());
+    write_array(ofs, hd.vertex_offset, vertex.data(), vertex.size());
+    ofs.seekp(hd.valid_offset);
+    ofs.write(valid.data(), valid.size());
+    write_array(ofs, hd.mqm_offset, problem.MQM.data(), problem.MQM.size());
+    write_array(ofs, hd.pos_offset, problem.position.data(), problem.position.size());
+    write_array(ofs, hd.vel_offset, problem.velocity.data(), problem.velocity.size());
+    write_array(ofs, hd.acc_offset, problem.acceleration.data(), problem.acceleration.size());
+    if(!ofs){
+        cout << "[Error]Failed writing " << fileName << endl;
+        return false;
+    }
+    return true;
+}
+
+
+// check that an array of n bytes at offset lies inside the file and is aligned for double
+static bool array_inside(uint64_t offset, uint64_t n, uint64_t file_size){
+    return offset % 8 == 0 && offset <= file_size && n <= file_size - offset;
+}
+
+
+bool TGProblemView::open(const std::string &fileName){
+    close();
+    if(!host_is_little_endian()){
+        cout << "[Error]The binary TGProblem format is little-endian only." << endl;
+        return false;
+    }
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if(fd < 0){
+        cout << "[Error]Cannot open " << fileName << endl;
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(TGPBinaryHeader)){
+        cout << "[Error]" << fileName << " is too short to be a binary TGProblem." << endl;
+        ::close(fd);
+        return false;
+    }
+    void *addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // the mapping keeps the file alive
+    if(addr == MAP_FAILED){
+        cout << "[Error]Cannot mmap " << fileName << endl;
+        return false;
+    }
+    data = static_cast<const char*>(addr);
+    size = st.st_size;
+
+    const TGPBinaryHeader &hd = header();
+    uint64_t seg = hd.segment_num;
+    bool okay = hd.magic == TGP_BINARY_MAGIC && hd.version == TGP_BINARY_VERSION && hd.header_size == sizeof(TGPBinaryHeader)
+        && hd.file_size == size
+        && array_inside(hd.bounds_offset, 6 * seg * sizeof(double), size)
+        && array_inside(hd.time_offset, seg * sizeof(double), size)
+        && array_inside(hd.center_offset, 3 * seg * sizeof(double), size)
+        && array_inside(hd.vertex_offset, 24 * seg * sizeof(double), size)
+        && hd.valid_offset <= size && seg <= size - hd.valid_offset
+        && array_inside(hd.mqm_offset, uint64_t(hd.mqm_rows) * hd.mqm_cols * sizeof(double), size)
+        && array_inside(hd.pos_offset, uint64_t(hd.pos_rows) * hd.pos_cols * sizeof(double), size)
+        && array_inside(hd.vel_offset, uint64_t(hd.vel_rows) * hd.vel_cols * sizeof(double), size)
+        && array_inside(hd.acc_offset, uint64_t(hd.acc_rows) * hd.acc_cols * sizeof(double), size);
+    if(!okay){
+        cout << "[Error]" << fileName << " is not a binary TGProblem of version " << TGP_BINARY_VERSION << endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+void TGProblemView::close(){
+    if(data != nullptr)
+        munmap(const_cast<char*>(data), size);
+    data = nullptr;
+    size = 0;
+}
+
+
+void TGProblemView::to_problem(TGProblem &problem) const{
+    const TGPBinaryHeader &hd = header();
+    int seg = segment_num();
+    MapRowMX bd = bounds(), ct = centers();
+    MapCVX tm = times();
+    problem.corridor.resize(seg);
+    for(int i = 0; i < seg; i++){
+        Box &box = problem.corridor[i];
+        box.vertex = vertex(i);
+        box.center = ct.row(i).transpose();
+        box.valid = valid(i);
+        box.t = tm(i);
+        box.box.resize(3);
+        for(int j = 0; j < 3; j++)
+            box.box[j] = std::make_pair(bd(i, 2 * j), bd(i, 2 * j + 1));
+    }
+    problem.MQM = MQM();
+    problem.position = position();
+    problem.velocity = velocity();
+    problem.acceleration = acceleration();
+    problem.maxVelocity = hd.max_velocity;
+    problem.maxAcceleration = hd.max_acceleration;
+    problem.trajectoryOrder = hd.trajectory_order;
+    problem.minimizeOrder = hd.minimize_order;
+    problem.margin = hd.margin;
+    problem.doLimitVelocity = (hd.flags & TGP_LIMIT_VELOCITY) != 0;
+    problem.doLimitAcceleration = (hd.flags & TGP_LIMIT_ACCELERATION) != 0;
+}
+
+
+bool loadTGProblemFromBinary(const std::string &fileName, TGProblem &problem){
+    TGProblemView view;
+    if(!view.open(fileName))
+        return false;
+    view.to_problem(problem);
+    return true;
+}
+
+
+bool isTGProblemBinary(const std::string &fileName){
+    std::ifstream ifs(fileName, std::ios::binary);
+    uint32_t magic = 0;
+    ifs.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    return ifs && magic == TGP_BINARY_MAGIC;
+}
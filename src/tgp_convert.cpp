@@ -0,0 +1,66 @@
+/*
+ * tgp_convert.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+/* Convert Boost text archives of TGProblem into the binary layout of tgp_binary.h.
+ * Usage: tgp_convert dataset/tgp_0.tgp dataset/tgp_1.tgp ...
+ * Each file is written next to its source with the extension .tgpb and read back to check it matches.
+ */
+
+#include "ott/tgp_binary.h"
+
+
+static bool same_box(const Box &a, const Box &b){
+    if(a.vertex != b.vertex || a.center != b.center || a.valid != b.valid || a.t != b.t || a.box.size() != b.box.size())
+        return false;
+    for(size_t i = 0; i < a.box.size(); i++)
+        if(a.box[i] != b.box[i])
+            return false;
+    return true;
+}
+
+
+static bool same_problem(const TGProblem &a, const TGProblem &b){
+    if(a.corridor.size() != b.corridor.size())
+        return false;
+    for(size_t i = 0; i < a.corridor.size(); i++)
+        if(!same_box(a.corridor[i], b.corridor[i]))
+            return false;
+    return a.MQM == b.MQM && a.position == b.position && a.velocity == b.velocity && a.acceleration == b.acceleration
+        && a.maxVelocity == b.maxVelocity && a.maxAcceleration == b.maxAcceleration && a.trajectoryOrder == b.trajectoryOrder
+        && a.minimizeOrder == b.minimizeOrder && a.margin == b.margin
+        && a.doLimitVelocity == b.doLimitVelocity && a.doLimitAcceleration == b.doLimitAcceleration;
+}
+
+
+static std::string binary_name(const std::string &fileName){
+    size_t dot = fileName.find_last_of('.');
+    size_t slash = fileName.find_last_of('/');
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return fileName + ".tgpb";
+    return fileName.substr(0, dot) + ".tgpb";
+}
+
+
+int main(int argc, char **argv){
+    if(argc < 2){
+        cout << "Usage: " << argv[0] << " problem.tgp [problem.tgp ...]" << endl;
+        return 1;
+    }
+    int num_fail = 0;
+    for(int i = 1; i < argc; i++){
+        std::string src(argv[i]), dst = binary_name(src);
+        TGProblem problem, check;
+        loadTGProblemFromFile(src, problem);
+        if(!saveTGProblemToBinary(problem, dst) || !loadTGProblemFromBinary(dst, check) || !same_problem(problem, check)){
+            cout << "[Error]Failed converting " << src << endl;
+            num_fail++;
+            continue;
+        }
+        cout << src << " -> " << dst << endl;
+    }
+    return num_fail == 0 ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+/*
+ * thread_pool.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <algorithm>
+
+#include "ott/thread_pool.h"
+
+
+WorkStealingPool::WorkStealingPool(int num_threads){
+    n_thread = num_threads;
+    if(n_thread <= 0)
+        n_thread = std::thread::hardware_concurrency();
+    if(n_thread <= 0)
+        n_thread = 1;
+    queues = std::vector<TaskQueue>(n_thread);
+}
+
+
+WorkStealingPool::WorkStealingPool(const WorkStealingPool &other) : WorkStealingPool(other.n_thread){}
+
+
+WorkStealingPool &WorkStealingPool::operator=(const WorkStealingPool &other){
+    if(this != &other && n_thread != other.n_thread){
+        stop();
+        n_thread = other.n_thread;
+        queues = std::vector<TaskQueue>(n_thread);
+    }
+    return *this;
+}
+
+
+WorkStealingPool::~WorkStealingPool(){
+    stop();
+}
+
+
+void WorkStealingPool::stop(){
+    {
+        std::lock_guard<std::mutex> guard(state_lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto &t : threads)
+        t.join();
+    threads.clear();
+    stopping = false;
+}
+
+
+bool WorkStealingPool::next_task(int worker, int &task){
+    {
+        TaskQueue &own = queues[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.tasks.empty()){
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    for(int i = 1; i < n_thread; i++){
+        TaskQueue &other = queues[(worker + i) % n_thread];
+        std::lock_guard<std::mutex> guard(other.lock);
+        if(!other.tasks.empty()){
+            task = other.tasks.back();
+            other.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// seen is the generation of the runs already over when the thread starts
+void WorkStealingPool::worker_loop(int worker, int seen){
+    while(true){
+        const std::function<void(int, int)> *fn;
+        {
+            std::unique_lock<std::mutex> guard(state_lock);
+            wake.wait(guard, [&]{return stopping || generation != seen;});
+            if(stopping)
+                return;
+            seen = generation;
+            if(worker >= n_active)
+                continue;
+            fn = job;
+        }
+        int task;
+        while(next_task(worker, task))
+            (*fn)(task, worker);
+        {
+            std::lock_guard<std::mutex> guard(state_lock);
+            if(--n_busy == 0)
+                done.notify_one();
+        }
+    }
+}
+
+
+void WorkStealingPool::run(int num_task, const std::function<void(int, int)> &fn){
+    int n_worker = std::min(n_thread, std::max(num_task, 1));
+    for(int i = 0; i < num_task; i++)
+        queues[i % n_worker].tasks.push_back(i);
+
+    if(n_worker > 1){
+        for(int w = threads.size() + 1; w < n_thread; w++)
+            threads.push_back(std::thread(&WorkStealingPool::worker_loop, this, w, generation));
+        {
+            std::lock_guard<std::mutex> guard(state_lock);
+            job = &fn;
+            n_active = n_worker;
+            n_busy = n_worker - 1;
+            generation++;
+        }
+        wake.notify_all();
+    }
+
+    int task;
+    while(next_task(0, task))  // the calling thread is worker 0
+        fn(task, 0);
+
+    if(n_worker > 1){
+        std::unique_lock<std::mutex> guard(state_lock);
+        done.wait(guard, [&]{return n_busy == 0;});
+        job = nullptr;
+    }
+}
@@ -0,0 +1,790 @@
+/*
+ * time_allocator.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <cmath>
+#include <chrono>
+#include <limits>
+
+#include "ott/time_allocator.h"
+#include "ott/problem_constructor.h"
+#include "ott/thread_pool.h"
+#include "ott/trace_recorder.h"
+
+
+static double seconds_since(const std::chrono::steady_clock::time_point &t0){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+
+// use the print level of the settings while computing a gradient and restore it afterwards
+class ScopedPrintLevel{
+public:
+    ScopedPrintLevel(int level) : previous(get_print_level()) {set_print_level(level);}
+    ~ScopedPrintLevel() {set_print_level(previous);}
+private:
+    int previous;
+};
+
+
+struct TimeAllocator::WorkerSet{
+    WorkStealingPool pool;
+    std::vector<TimeAllocator> allocators;  // at least one per worker of the pool
+};
+
+
+TimeAllocator::WorkerHandle::WorkerHandle(){}
+TimeAllocator::WorkerHandle::WorkerHandle(const WorkerHandle &){}
+TimeAllocator::WorkerHandle &TimeAllocator::WorkerHandle::operator=(const WorkerHandle &){
+    set.reset();  // the workers are copies of the allocator assigned over
+    return *this;
+}
+TimeAllocator::WorkerHandle::~WorkerHandle(){}
+
+
+TimeAllocator::TimeAllocator(const TGProblem &tgp, const MatrixXd &MQM_, const TimeAllocatorSettings &settings_, ProblemWorkspace *ws):
+    settings(settings_),
+    problem(tgp),
+    MQM(MQM_)
+{
+    for(auto &box : problem.corridor)
+        corridor.push_back(pyBox(box));
+    grad_corridor = corridor;
+    room_time.resize(corridor.size());
+    for(size_t i = 0; i < corridor.size(); i++)
+        room_time(i) = corridor[i].t;
+    size_t alloc0 = ws ? ws->num_alloc : 0;
+    constraint = ConstraintMatrix(
+                corridor,
+                MQM,
+                problem.position,
+                problem.velocity,
+                problem.acceleration,
+                problem.maxVelocity,
+                problem.maxAcceleration,
+                problem.trajectoryOrder,
+                problem.minimizeOrder,
+                problem.margin,
+                problem.doLimitVelocity,
+                problem.doLimitAcceleration,
+                ws);
+    objective = ObjectiveMatrix(problem.minimizeOrder, corridor.size(), problem.trajectoryOrder, room_time, MQM, "L");
+    split_qp = AxisSplitQP(objective.P, constraint.A, problem.trajectoryOrder + 1);
+    ipm = BandedIPMSolver(3 * (problem.trajectoryOrder + 1));
+    stats.n_workspace_alloc = ws ? ws->num_alloc - alloc0 : 0;
+    stats.n_var = constraint.lincon.n_var;
+    stats.n_con = constraint.lincon.n_con;
+    stats.nnz_P = objective.P.nonZeros();
+    stats.nnz_A = constraint.A.nonZeros();
+}
+
+
+bool TimeAllocator::solve_with_room_time(cRefVX rm_time){
+    room_time = rm_time;
+    for(size_t i = 0; i < corridor.size(); i++)
+        corridor[i].t = room_time(i);
+    return solve_once();
+}
+
+
+bool TimeAllocator::solve_once(){
+    update_matrices();
+    return solve_qp();
+}
+
+
+void TimeAllocator::set_warm_start(cRefVX x, cRefVX ly, cRefVX lz){
+    const LinearConstr &lincon = constraint.lincon;
+    VX z(lincon.n_con + lincon.n_var), y(lincon.n_con + lincon.n_var);
+    z << (constraint.A * x).cwiseMax(lincon.clb).cwiseMin(lincon.cub), x.cwiseMax(lincon.xlb).cwiseMin(lincon.xub);
+    y << ly, lz;
+    qp.set_warm_start(x, z, y);
+}
+
+
+bool TimeAllocator::set_solution(cRefVX rm_time, cRefVX x, cRefVX ly, cRefVX lz, double obj_){
+    const LinearConstr &lincon = constraint.lincon;
+    if(rm_time.size() != (int)corridor.size() || x.size() != (int)lincon.n_var || ly.size() != (int)lincon.n_con
+            || lz.size() != (int)lincon.n_var){
+        std::cout << "[Error]The solution does not match the size of the problem" << std::endl;
+        return false;
+    }
+    room_time = rm_time;
+    for(size_t i = 0; i < corridor.size(); i++)
+        corridor[i].t = room_time(i);
+    update_matrices();
+    sol = x;
+    lmdy = ly;
+    lmdz = lz;
+    obj = obj_;
+    is_solved = true;
+    set_warm_start(x, ly, lz);
+    return true;
+}
+
+
+VX TimeAllocator::segment_activity() const{
+    VX activity = VX::Zero(corridor.size());
+    if(!is_solved)
+        return activity;
+    const LinearConstr &lincon = constraint.lincon;
+    int seg_size = 3 * (problem.trajectoryOrder + 1);
+    std::vector<bool> counted(lincon.n_con, false);
+    for(int j = 0; j < constraint.A.outerSize(); j++){
+        activity(j / seg_size) += std::abs(lmdz(j));
+        for(SpMX::InnerIterator it(constraint.A, j); it; ++it){
+            int row = it.row();
+            if(!counted[row] && lincon.clb(row) != lincon.cub(row)){
+                counted[row] = true;
+                activity(j / seg_size) += std::abs(lmdy(row));
+            }
+        }
+    }
+    return activity;
+}
+
+
+void TimeAllocator::update_matrices(){
+    ScopedStatTimer timer(stat_timer(stats.t_assembly));
+    TraceSpan span("assembly");
+    objective.update_times(room_time);
+    constraint.update_times(room_time);
+    stats.n_assembly++;
+}
+
+
+bool TimeAllocator::solve_qp(){
+    ScopedStatTimer timer(stat_timer(stats.t_solve));
+    TraceSpan span("solve");
+    const LinearConstr &lincon = constraint.lincon;
+    bool use_ipm = settings.banded_ipm;
+    bool use_split = !use_ipm && settings.split_axes && split_qp.is_valid();
+    int status, iter;
+    double qp_obj;
+    if(use_ipm){
+        status = ipm.solve(objective.P, VX::Zero(lincon.n_var), constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+        qp_obj = ipm.obj;
+        iter = ipm.iter;
+    }
+    else if(use_split){
+        status = split_qp.solve(objective.P, constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+        qp_obj = split_qp.obj;
+        iter = split_qp.iter;
+    }
+    else{
+        status = qp.solve(objective.P, VX::Zero(lincon.n_var), constraint.A, lincon.clb, lincon.cub, lincon.xlb, lincon.xub);
+        qp_obj = qp.obj;
+        iter = qp.iter;
+    }
+    if(settings.verbose)
+        std::cout << "Solving status " << status << " iterations " << iter << std::endl;
+    // in case objective somehow falls below 0
+    is_solved = status == QP_SOLVED && qp_obj >= 0;
+    if(is_solved){
+        obj = qp_obj + settings.tfweight * room_time.sum();
+        sol = use_ipm ? ipm.x : use_split ? split_qp.x : qp.x;
+        lmdy = use_ipm ? ipm.lmdy : use_split ? split_qp.lmdy : qp.lmdy;
+        lmdz = use_ipm ? ipm.lmdz : use_split ? split_qp.lmdz : qp.lmdz;
+    }
+    else{
+        obj = std::numeric_limits<double>::infinity();
+        stats.n_solve_failed++;
+    }
+    stats.n_solve++;
+    if(span.active()){
+        span.arg("status", status);
+        span.arg("iter", iter);
+        span.arg("obj", obj);
+        if(is_solved){
+            double eps = qp.settings.eps_abs;
+            span.arg("active", (lmdy.array().abs() > eps).count() + (lmdz.array().abs() > eps).count());
+        }
+    }
+    stats.n_analyze = qp.analyze_count();
+    stats.n_factorize = qp.factorize_count();
+    for(int p = 0; p < 3; p++){
+        stats.n_analyze += split_qp.qp[p].analyze_count();
+        stats.n_factorize += split_qp.qp[p].factorize_count();
+    }
+    return is_solved;
+}
+
+
+VX TimeAllocator::get_gradient(){
+    ScopedStatTimer timer(stat_timer(stats.t_gradient));
+    TraceSpan span("gradient");
+    stats.n_gradient++;
+    return gradient_at(room_time, sol, lmdy, lmdz);
+}
+
+
+// the gradient formula evaluated at any times, solution and multipliers, they need not be optimal
+VX TimeAllocator::gradient_at(cRefVX rm_time, cRefVX x, cRefVX ly, cRefVX lz){
+    ScopedPrintLevel print_level(settings.print_level);
+    for(size_t i = 0; i < grad_corridor.size(); i++)
+        grad_corridor[i].t = rm_time(i);
+    VX grad = gradient_from_P(problem.minimizeOrder, grad_corridor.size(), problem.trajectoryOrder, rm_time, MQM, x);
+    grad += gradient_from_A(
+                grad_work,
+                grad_corridor,
+                MQM,
+                problem.position,
+                problem.velocity,
+                problem.acceleration,
+                problem.maxVelocity,
+                problem.maxAcceleration,
+                problem.trajectoryOrder,
+                problem.minimizeOrder,
+                problem.margin,
+                problem.doLimitVelocity,
+                problem.doLimitAcceleration,
+                x,
+                ly,
+                lz);
+    grad.array() += settings.tfweight;
+    return grad;
+}
+
+
+// derivatives of the last solution along dtime, only if it came from QPSolver and is still its last solve
+bool TimeAllocator::solution_derivative(cRefVX dtime, VX &dsol, VX &dlmdy, VX &dlmdz){
+    if(!is_solved || settings.banded_ipm || (settings.split_axes && split_qp.is_valid()))
+        return false;
+    if(qp.x.size() != sol.size() || qp.x != sol)
+        return false;
+    SpMX dP = objective.time_derivative(room_time, dtime);
+    SpMX dA;
+    VX dxlb, dxub;
+    if(!constraint.time_derivative(room_time, dtime, dA, dxlb, dxub))
+        return false;
+    const LinearConstr &lincon = constraint.lincon;
+    VX zero_con = VX::Zero(lincon.n_con);
+    return qp.sensitivity(dP, VX::Zero(lincon.n_var), dA, zero_con, zero_con, dxlb, dxub, dsol, dlmdy, dlmdz);
+}
+
+
+bool TimeAllocator::compute_sensitivity(cRefVX dtime){
+    sens.valid = false;
+    if(!solution_derivative(dtime, sens.dsol, sens.dlmdy, sens.dlmdz))
+        return false;
+    sens.time = room_time;
+    sens.dtime = dtime;
+    sens.sol = sol;
+    sens.lmdy = lmdy;
+    sens.lmdz = lmdz;
+    sens.valid = true;
+    return true;
+}
+
+
+// a multiplier predicted to cross zero is predicted to become inactive
+static VX predict_multiplier(cRefVX lmd, cRefVX dlmd, double alpha){
+    VX out = lmd + alpha * dlmd;
+    for(int i = 0; i < out.size(); i++)
+        if(out(i) * lmd(i) <= 0)
+            out(i) = 0;
+    return out;
+}
+
+
+bool TimeAllocator::solve_with_prediction(double alpha){
+    if(!sens.valid)
+        return false;
+    room_time = sens.time + alpha * sens.dtime;
+    for(size_t i = 0; i < corridor.size(); i++)
+        corridor[i].t = room_time(i);
+    update_matrices();
+    int n_con = constraint.lincon.n_con, n_var = constraint.lincon.n_var;
+    VX x = sens.sol + alpha * sens.dsol;
+    VX z(n_con + n_var), y(n_con + n_var);
+    z << constraint.A * x, x;
+    y << predict_multiplier(sens.lmdy, sens.dlmdy, alpha), predict_multiplier(sens.lmdz, sens.dlmdz, alpha);
+    qp.set_warm_start(x, z, y);
+    return solve_qp();
+}
+
+
+/* The gradient is G(t, x(t), y(t)) with G the explicit formula of gradient_at, so its derivative along v is the
+ * derivative of G along (v, dx, dy) where dx, dy come from differentiating the KKT system. G is smooth in all its
+ * arguments and that derivative is approximated by central differences, only dx and dy are exact. The step moves no
+ * time by more than 1e-3 of the shortest one, which keeps the O(h^2) error small against the cancellation in G.
+ * ott_regression compares the result with differences of get_gradient between solves.
+ */
+bool TimeAllocator::hessian_vector_product_fd(cRefVX v, VX &hv){
+    VX dsol, dlmdy, dlmdz;
+    if(!solution_derivative(v, dsol, dlmdy, dlmdz))
+        return false;
+    double vmax = v.lpNorm<Eigen::Infinity>();
+    if(vmax == 0){
+        hv = VX::Zero(v.size());
+        return true;
+    }
+    double h = 1e-3 * room_time.minCoeff() / vmax;
+    hv = (gradient_at(room_time + h * v, sol + h * dsol, lmdy + h * dlmdy, lmdz + h * dlmdz)
+          - gradient_at(room_time - h * v, sol - h * dsol, lmdy - h * dlmdy, lmdz - h * dlmdz)) / (2 * h);
+    return true;
+}
+
+
+bool TimeAllocator::get_hessian(MatrixXd &H){
+    int n_room = room_time.size();
+    H.resize(n_room, n_room);
+    VX e = VX::Zero(n_room), hv;
+    for(int k = 0; k < n_room; k++){
+        e(k) = 1;
+        if(!hessian_vector_product_fd(e, hv))
+            return false;
+        H.col(k) = hv;
+        e(k) = 0;
+    }
+    H = 0.5 * (H + H.transpose()).eval();
+    return true;
+}
+
+
+/* Difference quotients of obj along each column of dirs. Every perturbed problem is solved on its own copy of this
+ * allocator, warm started from the last solution whichever worker takes it, so the result does not depend on the
+ * number of threads.
+ */
+VX TimeAllocator::directional_differences(const MatrixXd &dirs, double h, bool central, int num_threads){
+    // both the forward differences and the warm start of every perturbed problem come from the last solution
+    if(!is_solved){
+        std::cout << "[Error]Finite differences need a solution, call solve_once or set_solution first" << std::endl;
+        return VX::Constant(dirs.cols(), std::numeric_limits<double>::quiet_NaN());
+    }
+    ScopedStatTimer timer(stat_timer(stats.t_gradient));
+    TraceSpan span("finite_difference");
+    int n_dir = dirs.cols();
+    int n_side = central ? 2 : 1;
+    VX objs(n_side * n_dir);
+    TrialStart start;
+    start.qp = qp.get_warm_start();
+    for(int p = 0; p < 3; p++)
+        start.split[p] = split_qp.qp[p].get_warm_start();
+    WorkerSet &set = worker_set(num_threads);
+    for(TimeAllocator &worker : set.allocators)
+        sync_worker(worker, start);
+    set.pool.run(n_side * n_dir, [&](int task, int w){
+        TimeAllocator &worker = set.allocators[w];
+        worker.restore_trial_start();
+        double sign = (task % n_side == 0) ? 1 : -1;
+        worker.solve_with_room_time(room_time + sign * h * dirs.col(task / n_side));
+        objs(task) = worker.obj;
+    });
+    for(const TimeAllocator &worker : set.allocators)
+        add_worker_counters(worker);
+    stats.n_solve += objs.size();
+    for(int i = 0; i < objs.size(); i++)
+        if(!std::isfinite(objs(i)))
+            stats.n_solve_failed++;
+    VX grad(n_dir);
+    for(int k = 0; k < n_dir; k++)
+        grad(k) = central ? (objs(2 * k) - objs(2 * k + 1)) / (2 * h) : (objs(k) - obj) / h;
+    return grad;
+}
+
+
+VX TimeAllocator::get_gradient_fd(double h, bool central, int num_threads){
+    int n_room = room_time.size();
+    return directional_differences(MatrixXd::Identity(n_room, n_room), h, central, num_threads);
+}
+
+
+VX TimeAllocator::get_gradient_mellinger(double h, bool central, int num_threads){
+    int n_room = room_time.size();
+    MatrixXd dirs = MatrixXd::Constant(n_room, n_room, n_room > 1 ? -1.0 / (n_room - 1) : 0.0);
+    dirs.diagonal().setOnes();
+    return directional_differences(dirs, h, central, num_threads);
+}
+
+
+/* Newton direction from the Hessian, restricted to sum(p) = 0 if the total time is fixed. Returns false if the
+ * Hessian is not available or the direction does not descend, then gradient descent is used.
+ */
+bool TimeAllocator::newton_direction(cRefVX grad, VX &p){
+    MatrixXd H;
+    if(!get_hessian(H))
+        return false;
+    int n_room = grad.size();
+    VX g = grad;
+    if(settings.tfweight == 0){
+        // project onto the subspace and put a positive curvature on its normal, that direction is removed from p below
+        MatrixXd Pm = MatrixXd::Identity(n_room, n_room) - MatrixXd::Constant(n_room, n_room, 1.0 / n_room);
+        double scale = std::max(H.diagonal().cwiseAbs().maxCoeff(), 1e-12);
+        H = Pm * H * Pm + MatrixXd::Constant(n_room, n_room, scale / n_room);
+        g = Pm * g;
+    }
+    // the cost is not convex in time and H is mostly indefinite, so flip negative curvature and floor small ones
+    Eigen::SelfAdjointEigenSolver<MatrixXd> es(H);
+    if(es.info() != Eigen::Success)
+        return false;
+    VX lam = es.eigenvalues().cwiseAbs();
+    double lam_min = 1e-3 * lam.maxCoeff();
+    if(!(lam_min > 0))
+        return false;
+    lam = lam.cwiseMax(lam_min);
+    p = -es.eigenvectors() * (es.eigenvectors().transpose() * g).cwiseQuotient(lam);
+    if(settings.tfweight == 0)
+        p.array() -= p.mean();
+    return grad.dot(p) < 0;
+}
+
+
+void TimeAllocator::save_trial_start(){
+    trial_start.qp = qp.get_warm_start();
+    for(int p = 0; p < 3; p++)
+        trial_start.split[p] = split_qp.qp[p].get_warm_start();
+}
+
+
+void TimeAllocator::restore_trial_start(){
+    qp.restore_warm_start(trial_start.qp);
+    for(int p = 0; p < 3; p++)
+        split_qp.qp[p].restore_warm_start(trial_start.split[p]);
+}
+
+
+TimeAllocator::WorkerSet &TimeAllocator::worker_set(int num_threads){
+    if(!workers.set)
+        workers.set.reset(new WorkerSet());
+    WorkerSet &set = *workers.set;
+    set.pool = WorkStealingPool(num_threads);  // keeps its threads if the size is the same
+    while((int)set.allocators.size() < set.pool.num_threads())
+        set.allocators.push_back(*this);
+    return set;
+}
+
+
+// pass over what a worker may have missed since it was copied, the problem and its matrices stay the same
+void TimeAllocator::sync_worker(TimeAllocator &worker, const TrialStart &start) const{
+    worker.settings = settings;
+    worker.settings.verbose = false;
+    worker.qp.settings = qp.settings;
+    worker.ipm.settings = ipm.settings;
+    for(int p = 0; p < 3; p++)
+        worker.split_qp.qp[p].settings = split_qp.qp[p].settings;
+    worker.split_qp.parallel = false;  // the pool already keeps the cores busy
+    worker.trial_start = start;
+    // so they count only the solves from here on, add_worker_counters passes them on
+    worker.qp.reset_counters();
+    for(int p = 0; p < 3; p++)
+        worker.split_qp.qp[p].reset_counters();
+}
+
+
+// count the solves of a worker since sync_worker as solves of this allocator
+void TimeAllocator::add_worker_counters(const TimeAllocator &worker){
+    qp.add_counters(worker.qp);
+    stats.n_analyze += worker.qp.analyze_count();
+    stats.n_factorize += worker.qp.factorize_count();
+    for(int p = 0; p < 3; p++){
+        split_qp.qp[p].add_counters(worker.split_qp.qp[p]);
+        stats.n_analyze += worker.split_qp.qp[p].analyze_count();
+        stats.n_factorize += worker.split_qp.qp[p].factorize_count();
+    }
+}
+
+
+/* Solve the trials of the line search from j on concurrently, one per worker, each starting from the solver state of
+ * this allocator at the start of the search. The step lengths and the trials skipped follow the sequential search
+ * exactly. Returns the index of the first trial not solved.
+ */
+int TimeAllocator::solve_trials(WorkerSet &set, int j, double alpha, cRefVX t_now, cRefVX p,
+        bool use_prediction, std::vector<int> &slot){
+    std::vector<TimeAllocator> &copies = set.allocators;
+    std::vector<double> alphas;
+    int j_end = j;
+    for(; j_end < settings.j_iter && (int)alphas.size() < set.pool.num_threads(); j_end++, alpha = settings.tau * alpha){
+        if(settings.adaptive_line_search && alpha < 1e-4){
+            j_end = settings.j_iter;  // the sequential search stops here
+            break;
+        }
+        if(((t_now + alpha * p).array() < 1e-6).any())
+            continue;
+        slot[j_end] = alphas.size();
+        alphas.push_back(alpha);
+    }
+    ScopedStatTimer timer(stat_timer(stats.t_solve));
+    TraceSpan span("solve_ahead");
+    span.arg("trials", alphas.size());
+    for(size_t i = 0; i < alphas.size(); i++){
+        sync_worker(copies[i], trial_start);
+        copies[i].sens = sens;
+    }
+    set.pool.run(alphas.size(), [&](int task, int){
+        TimeAllocator &worker = copies[task];
+        worker.restore_trial_start();
+        if(use_prediction)
+            worker.solve_with_prediction(alphas[task]);
+        else
+            worker.solve_with_room_time(t_now + alphas[task] * p);
+    });
+    num_prob_solve += alphas.size();
+    stats.n_solve += alphas.size();
+    for(size_t i = 0; i < alphas.size(); i++){
+        if(!copies[i].is_solved)
+            stats.n_solve_failed++;
+        add_worker_counters(copies[i]);
+    }
+    return j_end;
+}
+
+
+// take over the times, matrices, solver states and solution of a trial solved on a copy
+void TimeAllocator::take_trial(const TimeAllocator &trial){
+    room_time = trial.room_time;
+    corridor = trial.corridor;
+    objective = trial.objective;
+    constraint = trial.constraint;
+    // the solver counters stay, solve_trials already added those of the worker
+    qp.take_solution(trial.qp);
+    split_qp.take_solution(trial.split_qp);
+    ipm = trial.ipm;
+    sol = trial.sol;
+    lmdy = trial.lmdy;
+    lmdz = trial.lmdz;
+    obj = trial.obj;
+    is_solved = trial.is_solved;
+}
+
+
+std::pair<bool, bool> TimeAllocator::refine_time_by_backtrack(){
+    auto t0 = std::chrono::steady_clock::now();
+    TraceSpan span("refine");
+    span.arg("segments", corridor.size());
+    major_iteration = 0;
+    num_prob_solve = 0;
+    int n_room = corridor.size();
+
+    if(!is_solved)
+        solve_once();
+    // there is no gradient without a solution, e.g. a start state from odometry outside the first box
+    if(!is_solved){
+        time_cost = seconds_since(t0);
+        converge_reason = "Initial problem not solved";
+        return std::make_pair(false, false);
+    }
+
+    log.clear();
+    if(settings.log){
+        log.reserve(2 * (settings.max_iter + 1));
+        log.push_back(obj);
+        log.push_back(0);
+    }
+
+    if(n_room == 1 && settings.tfweight == 0){
+        time_cost = seconds_since(t0);
+        if(settings.collect_stats)
+            stats.t_refine += time_cost;
+        converge_reason = "No need to refine";
+        return std::make_pair(true, true);
+    }
+
+    double alpha0 = settings.alpha0;
+    const double c = settings.c;
+    const double tau = settings.tau;
+
+    VX t_now = room_time;
+    VX candid_time(n_room), grad(n_room), p(n_room);
+    // keep the accepted solution so we can roll back if the line search fails
+    VX sol0, lmdy0, lmdz0;
+    QPSolver qp_now;
+
+    bool is_okay = true;
+    bool converged = false;
+    converge_reason = "Not converged";
+    // copies of this allocator that solve trials of the line search ahead, slot is the copy holding each trial
+    bool parallel = settings.line_search_threads > 1;
+    WorkerSet *set = parallel ? &worker_set(settings.line_search_threads) : nullptr;
+    std::vector<int> slot(std::max(settings.j_iter, 0), -1);
+    int i = 0;
+    for(i = 0; i < settings.max_iter; i++){
+        if(settings.verbose)
+            std::cout << "Iteration " << i << std::endl;
+        TraceSpan iteration_span("iteration");
+        iteration_span.arg("iteration", i);
+
+        double obj0 = obj;
+        double objf = obj;
+        is_okay = true;
+
+        grad = get_gradient();
+        if(settings.tfweight == 0){
+            // get projected gradient, the linear manifold is \sum x_i = 0; if tfweight=0, we fix total time
+            grad.array() -= grad.mean();
+        }
+        iteration_span.arg("grad_norm", grad.norm());
+        if(grad.norm() < settings.grad_tol){
+            converged = true;
+            converge_reason = "Small gradient";
+            break;
+        }
+        // a Newton step is tried at full length, a gradient step is normalized and uses the adaptive alpha0
+        bool newton = settings.newton_step && newton_direction(grad, p);
+        ScopedStatTimer line_search_timer(stat_timer(stats.t_line_search));
+        sol0 = sol;
+        lmdy0 = lmdy;
+        lmdz0 = lmdz;
+        bool alpha_found = false;
+        int last_slot = -1;  // worker of the last trial looked at
+        // a failed Newton step falls back to the gradient from t_now within this iteration
+        while(true){
+            double m;
+            if(newton){
+                m = grad.dot(p);
+            }
+            else{
+                m = -grad.norm();
+                p = grad / m;  // p is the descending direction
+            }
+            // use a maximum alpha that makes sure time are always positive
+            double alpha_max = -std::numeric_limits<double>::infinity();
+            for(int k = 0; k < n_room; k++)
+                alpha_max = std::max(alpha_max, -t_now(k) / p(k));
+            alpha_max -= 1e-6;
+            double alpha_init = newton ? 1.0 : alpha0;
+            double alpha = (alpha_max > 0) ? std::min(alpha_max, alpha_init) : alpha_init;
+            double t = -c * m;
+
+            bool use_prediction = settings.predict_solution && compute_sensitivity(p);
+            save_trial_start();
+            // a failed Newton step falls back to a gradient step from t_now, compute_sensitivity needs the solve there
+            if(newton && !parallel)
+                qp_now = qp;
+
+            // find alpha
+            alpha_found = false;
+            int solved_end = 0;  // trials before this one were solved ahead by the workers
+            last_slot = -1;
+            for(int j = 0; j < settings.j_iter; j++){
+                if(settings.verbose)
+                    std::cout << "Search alpha step " << j << ", alpha = " << alpha << std::endl;
+                candid_time = t_now + alpha * p;
+
+                // lower bound on the alpha
+                if(settings.adaptive_line_search && alpha < 1e-4)
+                    break;
+
+                // make sure that time will not go too small
+                if((candid_time.array() < 1e-6).any()){
+                    alpha = tau * alpha;
+                    continue;
+                }
+                bool trial_solved;
+                double trial_obj;
+                stats.n_trial++;
+                TraceSpan trial_span("trial");
+                trial_span.arg("alpha", alpha);
+                if(parallel){
+                    if(j >= solved_end)
+                        solved_end = solve_trials(*set, j, alpha, t_now, p, use_prediction, slot);
+                    last_slot = slot[j];
+                    trial_solved = set->allocators[last_slot].is_solved;
+                    trial_obj = set->allocators[last_slot].obj;
+                }
+                else{
+                    restore_trial_start();
+                    if(use_prediction)
+                        solve_with_prediction(alpha);
+                    else
+                        solve_with_room_time(candid_time);
+                    num_prob_solve++;
+                    trial_solved = is_solved;
+                    trial_obj = obj;
+                }
+                trial_span.arg("obj", trial_obj);
+                if(!trial_solved){
+                    stats.n_rejected++;
+                    alpha = tau * alpha;  // decrease step length
+                    continue;
+                }
+                objf = trial_obj;
+                if(settings.verbose)
+                    std::cout << "\talpha " << alpha << " obj0 " << obj0 << " objf " << objf << std::endl;
+                if(obj0 - objf >= alpha * t || obj0 - objf >= 0.1 * obj0){  // either backtrack or decrease sufficiently
+                    alpha_found = true;
+                    trial_span.arg("accepted", 1);
+                    iteration_span.arg("alpha", alpha);
+                    iteration_span.arg("obj", objf);
+                    if(settings.adaptive_line_search && !newton){
+                        // increase the initial alpha if alpha is good enough for the first time,
+                        // otherwise the next iteration starts from this alpha
+                        if(j == 0)
+                            alpha0 = 1.5 * alpha;
+                        else
+                            alpha0 = alpha;
+                    }
+                    break;
+                }
+                else{
+                    stats.n_rejected++;
+                    alpha = tau * alpha;  // decrease step length
+                }
+            }
+
+            if(alpha_found)
+                break;
+            // roll back to t_now, the solution there is still around so no need to solve again
+            room_time = t_now;
+            for(int k = 0; k < n_room; k++)
+                corridor[k].t = t_now(k);
+            obj = obj0;
+            sol = sol0;
+            lmdy = lmdy0;
+            lmdz = lmdz0;
+            is_solved = true;
+            // with workers this allocator still holds the matrices and solver state of t_now,
+            // otherwise the trials changed them
+            if(!parallel){
+                update_matrices();
+                restore_trial_start();
+                if(newton)
+                    qp = qp_now;
+            }
+            if(!newton)
+                break;
+            // the quadratic model was poor here, take a gradient step instead
+            newton = false;
+        }
+
+        if(!alpha_found){
+            converge_reason = "Cannot find step size alpha";
+            is_okay = true;
+            converged = false;
+            if(settings.log){
+                log.push_back(obj0);
+                log.push_back(seconds_since(t0));
+            }
+            break;
+        }
+
+        // take over the accepted trial if a worker solved it, as if it was solved here
+        if(last_slot >= 0)
+            take_trial(set->allocators[last_slot]);
+
+        // ready to update time now and check convergence
+        t_now = candid_time;
+        if(settings.log){
+            log.push_back(objf);
+            log.push_back(seconds_since(t0));
+        }
+        if(std::abs(objf - obj0) < settings.abs_obj_tol){
+            converged = true;
+            converge_reason = "Absolute cost";
+            break;
+        }
+        else if(std::abs(objf - obj0) / std::abs(obj0) < settings.rel_obj_tol){
+            converged = true;
+            converge_reason = "Relative cost";
+            break;
+        }
+    }
+    major_iteration = std::min(i, settings.max_iter - 1);
+    time_cost = seconds_since(t0);
+    if(settings.collect_stats)
+        stats.t_refine += time_cost;
+    return std::make_pair(is_okay, converged);
+}
@@ -0,0 +1,100 @@
+/*
+ * trace_recorder.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "ott/trace_recorder.h"
+
+
+static std::atomic<TraceRecorder*> TRACER(nullptr);
+
+void set_tracer(TraceRecorder *tracer){
+    TRACER.store(tracer);
+}
+
+TraceRecorder *get_tracer(){
+    return TRACER.load(std::memory_order_relaxed);
+}
+
+
+TraceRecorder::TraceRecorder(size_t capacity) : origin(std::chrono::steady_clock::now()), events(std::max<size_t>(capacity, 1)){
+    threads.reserve(64);
+}
+
+
+void TraceRecorder::add(Event event, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end){
+    event.ts = std::chrono::duration<double, std::micro>(start - origin).count();
+    event.dur = std::chrono::duration<double, std::micro>(end - start).count();
+    std::thread::id self = std::this_thread::get_id();
+    std::lock_guard<std::mutex> guard(lock);
+    size_t tid = 0;
+    while(tid < threads.size() && threads[tid] != self)
+        tid++;
+    if(tid == threads.size())
+        threads.push_back(self);
+    event.tid = tid;
+    events[head] = event;
+    head = (head + 1) % events.size();
+    if(count < events.size())
+        count++;
+    else
+        n_dropped++;
+}
+
+
+void TraceRecorder::clear(){
+    std::lock_guard<std::mutex> guard(lock);
+    head = 0;
+    count = 0;
+    n_dropped = 0;
+}
+
+
+std::string TraceRecorder::to_json() const{
+    std::lock_guard<std::mutex> guard(lock);
+    std::string out = "{\"traceEvents\": [\n";
+    char buf[256];
+    size_t first = (head + events.size() - count) % events.size();
+    for(size_t i = 0; i < count; i++){
+        const Event &e = events[(first + i) % events.size()];
+        snprintf(buf, sizeof(buf), "{\"name\": \"%s\", \"cat\": \"ott\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                 e.name, e.tid, e.ts, e.dur);
+        out += buf;
+        if(e.n_args > 0){
+            out += ", \"args\": {";
+            for(int k = 0; k < e.n_args; k++){
+                // JSON has no inf or nan
+                if(std::isfinite(e.values[k]))
+                    snprintf(buf, sizeof(buf), "%s\"%s\": %.10g", k > 0 ? ", " : "", e.keys[k], e.values[k]);
+                else
+                    snprintf(buf, sizeof(buf), "%s\"%s\": null", k > 0 ? ", " : "", e.keys[k]);
+                out += buf;
+            }
+            out += "}";
+        }
+        out += i + 1 < count ? "},\n" : "}\n";
+    }
+    snprintf(buf, sizeof(buf), "], \"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped\": %d}}\n", (int)n_dropped);
+    out += buf;
+    return out;
+}
+
+
+bool TraceRecorder::write_json(const std::string &file_name) const{
+    std::ofstream ofs(file_name);
+    if(!ofs){
+        std::cout << "[Error]Cannot open " << file_name << std::endl;
+        return false;
+    }
+    ofs << to_json();
+    return bool(ofs);
+}
@@ -0,0 +1,98 @@
+/*
+ * trajectory_evaluator.cpp
+ * Copyright (C) 2018 Gao Tang <gt70@duke.edu>
+ *
+ * Distributed under terms of the MIT license.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "ott/trajectory_evaluator.h"
+
+
+TrajectoryEvaluator::TrajectoryEvaluator(const MatrixXd &M_, cRefVX sol, cRefVX room_time):
+    M(M_),
+    poly_order(M_.rows() - 1)
+{
+    set_solution(sol, room_time);
+}
+
+
+void TrajectoryEvaluator::set_solution(cRefVX sol, cRefVX room_time){
+    int n_ctrl = poly_order + 1;
+    int n_seg = room_time.size();
+    if(sol.size() != 3 * n_ctrl * n_seg){
+        std::cout << "[Error]sol has " << sol.size() << " entries, " << 3 * n_ctrl * n_seg << " expected" << std::endl;
+        end_time.resize(0);
+        coef.resize(4, 0);
+        return;
+    }
+    end_time.resize(n_seg);
+    coef.setZero(4, n_seg * n_ctrl);
+    double cum_time = 0;
+    for(int i = 0; i < n_seg; i++){
+        cum_time += room_time(i);
+        end_time(i) = cum_time;
+        // sol holds the control points of x, y, z of each segment scaled by 1 / room_time
+        MatrixXd poly = M * Eigen::Map<const MatrixXd>(sol.data() + 3 * n_ctrl * i, n_ctrl, 3) * room_time(i);
+        // from s = (t - start) / room_time to t - start
+        double scale = 1;
+        for(int k = 0; k < n_ctrl; k++){
+            coef.block(0, i * n_ctrl + k, 3, 1) = poly.row(k).transpose() * scale;
+            scale /= room_time(i);
+        }
+    }
+}
+
+
+int TrajectoryEvaluator::locate(double t) const{
+    const double *first = end_time.data(), *last = end_time.data() + end_time.size();
+    int seg = std::lower_bound(first, last, t) - first;
+    return std::min(seg, (int)end_time.size() - 1);
+}
+
+
+void TrajectoryEvaluator::evaluate(const double *times, int n, int max_deriv, double *out) const{
+    int n_seg = end_time.size();
+    int n_out = 3 * (max_deriv + 1);
+    std::fill(out, out + (size_t)n * n_out, 0.0);
+    if(n_seg == 0 || max_deriv < 0)
+        return;
+    int n_ctrl = poly_order + 1;
+    int n_deriv = std::min(max_deriv, poly_order);  // the higher ones are 0
+    std::vector<Eigen::Array4d, Eigen::aligned_allocator<Eigen::Array4d> > pd(n_deriv + 1);
+    std::vector<double> factorial(n_deriv + 1, 1.0);
+    for(int j = 2; j <= n_deriv; j++)
+        factorial[j] = factorial[j - 1] * j;
+
+    int seg = 0;
+    for(int q = 0; q < n; q++){
+        double t = std::min(std::max(times[q], 0.0), total_time());
+        // sorted times mostly stay in the segment of the previous query or move to the next one
+        if(!(t <= end_time(seg) && (seg == 0 || t > end_time(seg - 1)))){
+            if(seg + 1 < n_seg && t > end_time(seg) && t <= end_time(seg + 1))
+                seg++;
+            else
+                seg = locate(t);
+        }
+        double tau = seg == 0 ? t : t - end_time(seg - 1);
+
+        // Horner on the polynomial and its derivatives at once, x, y, z in one packet
+        const double *c = coef.data() + 4 * (size_t)seg * n_ctrl;
+        pd[0] = Eigen::Map<const Eigen::Array4d>(c + 4 * poly_order);
+        for(int j = 1; j <= n_deriv; j++)
+            pd[j].setZero();
+        for(int k = poly_order - 1; k >= 0; k--){
+            for(int j = std::min(n_deriv, poly_order - k); j >= 1; j--)
+                pd[j] = pd[j] * tau + pd[j - 1];
+            pd[0] = pd[0] * tau + Eigen::Map<const Eigen::Array4d>(c + 4 * k);
+        }
+
+        double *row = out + (size_t)q * n_out;
+        for(int j = 0; j <= n_deriv; j++)
+            for(int p = 0; p < 3; p++)
+                row[3 * j + p] = factorial[j] * pd[j](p);
+    }
+}